@@ -78,6 +78,7 @@ typedef struct {
     uint32_t stopwatch_start;
     uint32_t stopwatch_elapsed;
     bool stopwatch_running;
+    SoftTimerHandle update_timer;
     uint32_t* lap_times;
     size_t lap_count;
     SecureStorage* settings_storage;
@@ -267,19 +268,6 @@ static void clock_timer_callback(void* data) {
     if (app_state.stopwatch_running) {
         update_stopwatch_display();
     }
-    
-    // Schedule next update
-    TimerConfig timer_config = {
-        .interval_ms = 1000,
-        .repeat = true,
-        .callback = clock_timer_callback,
-        .callback_data = NULL
-    };
-    
-    if (hal_timer_start(0, &timer_config) != CLOCK_HAL_SUCCESS) {
-        // Handle error
-        return;
-    }
 }
 
 // Tab switching
@@ -533,15 +521,17 @@ static void on_create(void) {
     init_ui();
     init_storage();
     
-    // Configure and start update timer
+    // Configure and start update timer. A little slack lets the tick share
+    // wakeups with other apps' timers.
     TimerConfig timer_config = {
         .interval_ms = 1000,
         .repeat = true,
         .callback = clock_timer_callback,
-        .callback_data = NULL
+        .callback_data = NULL,
+        .slack_ms = 50
     };
     
-    if (hal_timer_start(0, &timer_config) != CLOCK_HAL_SUCCESS) {
+    if (hal_soft_timer_start(&timer_config, &app_state.update_timer) != CLOCK_HAL_SUCCESS) {
         // Handle error
         return;
     }
@@ -553,7 +543,8 @@ static void on_create(void) {
 
 static void on_destroy(void) {
     // Stop timer
-    hal_timer_stop(0);
+    hal_soft_timer_cancel(app_state.update_timer);
+    app_state.update_timer = 0;
     
     // Disable all alarms
     for (size_t i = 0; i < MAX_HW_ALARMS; i++) {
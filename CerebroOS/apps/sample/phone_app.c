@@ -2,9 +2,14 @@
 #include "../../os/ui_framework.h"
 #include "../../os/network.h"
 #include "../../os/security.h"
+#include "../../os/scheduler.h"
 #include <string.h>
 #include <stdio.h>
 
+// In-call display refresh, run by the periodic real-time class
+#define CALL_TICK_PERIOD_US 1000000
+#define CALL_TICK_BUDGET_US 1000
+
 // Call states
 typedef enum {
     CALL_STATE_IDLE,
@@ -74,7 +79,7 @@ typedef struct {
     Contact* contacts;
     size_t contact_count;
     SecureStorage* contacts_storage;
-    uint32_t call_timer_id;
+    int call_tick_task;  // Periodic task id, -1 outside a call
 } PhoneApp;
 
 static PhoneApp app_state;
@@ -99,6 +104,21 @@ static void update_call_duration(void) {
     ui_set_text((UiElement*)app_state.duration_label, duration_text);
 }
 
+static void call_tick(void* context) {
+    (void)context;
+    update_call_duration();
+}
+
+// Refresh the call display once a second for as long as a call exists
+static void start_call_tick(void) {
+    PeriodicTaskParams tick = {
+        .job = call_tick,
+        .period_us = CALL_TICK_PERIOD_US,
+        .budget_us = CALL_TICK_BUDGET_US
+    };
+    app_state.call_tick_task = scheduler_add_periodic(&tick);
+}
+
 // Handle incoming call
 static void handle_incoming_call(const char* number) {
     if (app_state.current_call) {
@@ -134,6 +154,7 @@ static void handle_incoming_call(const char* number) {
              app_state.current_call->name : 
              app_state.current_call->number);
     ui_set_text((UiElement*)app_state.caller_label, caller_text);
+    start_call_tick();
 }
 
 // Start outgoing call
@@ -170,6 +191,7 @@ static void start_call(const char* number) {
              app_state.current_call->name : 
              app_state.current_call->number);
     ui_set_text((UiElement*)app_state.caller_label, caller_text);
+    start_call_tick();
     
     // Start call via system
     // Implementation depends on hardware abstraction layer
@@ -184,6 +206,8 @@ static void end_call(void) {
     // End call via system
     // Implementation depends on hardware abstraction layer
     
+    scheduler_remove_periodic(app_state.call_tick_task);
+    app_state.call_tick_task = -1;
     free(app_state.current_call);
     app_state.current_call = NULL;
     
@@ -382,6 +406,7 @@ static void init_storage(void) {
 // App lifecycle callbacks
 static void on_create(void) {
     memset(&app_state, 0, sizeof(PhoneApp));
+    app_state.call_tick_task = -1;
     
     // Initialize components
     init_ui();
@@ -1,5 +1,6 @@
 #include "voice_recognition.h"
 #include "../ai_models/tensorflow_lite/tensorflow_lite.h"
+#include "../../kernel/memory_manager.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -8,6 +9,9 @@
 #define AUDIO_INPUT_SIZE 16000 // Example size, adjust based on your model
 #define LABEL_BUFFER_SIZE 50  // Max length of a command label
 
+// Scratch memory for preprocessing, released after every sample
+static MemoryArena* preprocess_arena = NULL;
+
 static const char* labels[MAX_LABELS] = {
     "turn on light",
     "turn off light",
@@ -42,14 +46,28 @@ VoiceRecognitionError process_audio_sample(const int16_t* audio_data, int audio_
     }
 
     // Preprocessing (if needed)
-    float input_data[AUDIO_INPUT_SIZE];
+    if (!preprocess_arena) {
+        preprocess_arena = memory_arena_create(AUDIO_INPUT_SIZE * sizeof(float));
+        if (!preprocess_arena) {
+            return VOICE_RECOGNITION_ERROR_INFERENCE;
+        }
+    }
+    float* input_data = memory_arena_alloc(preprocess_arena, AUDIO_INPUT_SIZE * sizeof(float));
+    if (!input_data) {
+        return VOICE_RECOGNITION_ERROR_INFERENCE; // Over the temp limit or out of heap
+    }
+    if (audio_size > AUDIO_INPUT_SIZE) {
+        audio_size = AUDIO_INPUT_SIZE;
+    }
     for (int i = 0; i < audio_size; i++) {
         input_data[i] = (float)audio_data[i] / 32768.0f; // Normalize to [-1, 1]
     }
+    memset(input_data + audio_size, 0, (AUDIO_INPUT_SIZE - audio_size) * sizeof(float));
 
     // Run Inference
     float output[MAX_LABELS];
     TfLiteError tflite_error = run_inference(input_data, AUDIO_INPUT_SIZE, output, MAX_LABELS);
+    memory_arena_reset(preprocess_arena);
     if (tflite_error != kTfLiteOk) {
         return VOICE_RECOGNITION_ERROR_INFERENCE;
     }
@@ -1,24 +1,39 @@
 #include "audio_driver.h"
+#include "../kernel/kernel.h"
+#include "../os/scheduler.h"
 #include <SDL2/SDL.h>
 #include <math.h> 
+#include <stdatomic.h>
 
 #define SAMPLE_RATE 22050          // Reduced sample rate for smaller devices
 #define AUDIO_BUFFER_SIZE 1024     // Smaller buffer for reduced latency
 
+// Mixing runs as a periodic real-time task, one buffer period per job. The
+// budget is generous for a table lookup per sample but keeps admission
+// honest if real mixing lands here.
+#define AUDIO_PERIOD_US ((uint32_t)((uint64_t)AUDIO_BUFFER_SIZE * 1000000 / SAMPLE_RATE))
+#define AUDIO_MIX_BUDGET_US 2000
+
+// Triple buffer between the mixing job (kernel loop) and SDL's audio thread.
+// Each side owns one buffer; the third is swapped through mix_middle, whose
+// MIX_FRESH bit says the mixer published it since the device last took one.
+#define MIX_FRESH 4
+
 static SDL_AudioDeviceID audio_device = 0;
 static float current_volume = 1.0f;
 static bool audio_playing = false;  // Flag to track audio playback
+static int mix_task = -1;           // Periodic task id, -1 when mixing inline
 
-// Audio Callback (optimized for performance)
-void audio_callback(void* userdata, Uint8* stream, int len) {
-    static float t = 0;
-    int16_t* samples = (int16_t*)stream;
-    int sample_count = len / sizeof(int16_t);
+static int16_t mix_buffers[3][AUDIO_BUFFER_SIZE];
+static int mix_back = 0;            // Mixer's buffer
+static int mix_front = 1;           // Device's buffer
+static atomic_int mix_middle = 2;
 
-    // Use a pre-calculated table of sine values for speed
-    static int16_t sine_table[AUDIO_BUFFER_SIZE];
-    static bool sine_table_initialized = false;
+// Use a pre-calculated table of sine values for speed
+static int16_t sine_table[AUDIO_BUFFER_SIZE];
+static bool sine_table_initialized = false;
 
+static void mix_samples(int16_t* samples, int sample_count) {
     // Initialize sine table only once
     if (!sine_table_initialized) {
         for (int i = 0; i < AUDIO_BUFFER_SIZE; ++i) {
@@ -27,14 +42,41 @@ void audio_callback(void* userdata, Uint8* stream, int len) {
         sine_table_initialized = true;
     }
 
-    // Fill the stream using the sine table
     for (int i = 0; i < sample_count; ++i) {
         samples[i] = (int16_t)(sine_table[i % AUDIO_BUFFER_SIZE] * current_volume);
-        t += 2.0 * M_PI * 440.0 / SAMPLE_RATE; 
-        if (t > 2.0 * M_PI) t -= 2.0 * M_PI;
     }
 }
 
+// Periodic job: mix the next buffer and hand it to the device side
+static void audio_mix_job(void* context) {
+    (void)context;
+    mix_samples(mix_buffers[mix_back], AUDIO_BUFFER_SIZE);
+    mix_back = atomic_exchange_explicit(&mix_middle, mix_back | MIX_FRESH, memory_order_acq_rel) & ~MIX_FRESH;
+}
+
+// Audio Callback (optimized for performance)
+void audio_callback(void* userdata, Uint8* stream, int len) {
+    int16_t* samples = (int16_t*)stream;
+    int sample_count = len / sizeof(int16_t);
+
+    if (mix_task < 0) {
+        // Not admitted as a periodic task; mix on the audio thread
+        mix_samples(samples, sample_count);
+    } else {
+        // Take the newest mixed buffer; on an underrun replay the last one
+        if (atomic_load_explicit(&mix_middle, memory_order_acquire) & MIX_FRESH) {
+            mix_front = atomic_exchange_explicit(&mix_middle, mix_front, memory_order_acq_rel) & ~MIX_FRESH;
+        }
+        for (int i = 0; i < sample_count; ++i) {
+            samples[i] = mix_buffers[mix_front][i % AUDIO_BUFFER_SIZE];
+        }
+    }
+
+    // Runs on SDL's audio thread; tell the kernel loop without locking
+    KernelEventRecord event = { .type = KERNEL_EVENT_AUDIO_BUFFER, .data.value = (uint32_t)sample_count };
+    kernel_post_event(&event);
+}
+
 // Audio Initialization (with error handling)
 AudioError audio_init() {
     // SDL Audio Initialization
@@ -59,6 +101,16 @@ AudioError audio_init() {
         return AUDIO_ERROR_OPEN;
     }
 
+    // Mix ahead on the kernel loop under EDF so a busy frame cannot starve
+    // the device; if admission fails the callback mixes for itself
+    mix_samples(mix_buffers[mix_front], AUDIO_BUFFER_SIZE);
+    PeriodicTaskParams mix = {
+        .job = audio_mix_job,
+        .period_us = AUDIO_PERIOD_US,
+        .budget_us = AUDIO_MIX_BUDGET_US
+    };
+    mix_task = scheduler_add_periodic(&mix);
+
     return AUDIO_ERROR_NONE; 
 }
 
@@ -109,5 +161,7 @@ void audio_cleanup() {
     if (audio_device != 0) {
         SDL_CloseAudioDevice(audio_device);
     }
+    scheduler_remove_periodic(mix_task);
+    mix_task = -1;
     SDL_QuitSubSystem(SDL_INIT_AUDIO);
 }
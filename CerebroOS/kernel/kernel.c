@@ -1,18 +1,286 @@
+#if defined(__linux__)
+#define _GNU_SOURCE  // eventfd, timerfd, epoll
+#endif
 #include "kernel.h"
 #include "memory_manager.h"
 #include "process_manager.h"
 #include "drivers/display_driver.h"
 #include "ui/ui_manager.h"
+#include "os/scheduler.h"
+#include "os/app_framework.h"
+#include "os/hal/clock_hal.h"
 #include "power_management.h" 
 #include "error_handler.h"  // Optional, for logging errors
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Bytes of heap the idle loop may compact per iteration
+#define DEFRAG_SLICE_BYTES (4 * 1024)
+
+// Fragmentation (percent of free heap) at which idle compaction starts a pass
+#define DEFRAG_START_PERCENT 25
+
+// Default longest sleep while input has to be polled (SDL in the emulator
+// has no file descriptor to wait on). One 60 Hz frame.
+#define DEFAULT_INPUT_POLL_MS 16
+
+#define MAX_WAKE_FDS 8
+
+// Event queue slots (a power of two) and the most events handled per loop
+// pass before the rest of the loop gets a turn
+#define EVENT_QUEUE_SIZE 64
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SIZE - 1)
+#define EVENT_BATCH_SIZE 16
+
+// Deferred app events delivered per loop pass
+#define APP_EVENT_BATCH 64
+
+// Bounded multi-producer, single-consumer ring. Each slot's sequence tells
+// whose turn it is: equal to the ticket, a producer may fill it; ticket + 1,
+// the consumer may read it; ticket + size, it is free for the next lap.
+// Producers claim tickets with a CAS, so no post ever blocks on another.
+typedef struct {
+    atomic_uint sequence;
+    KernelEventRecord record;
+} EventSlot;
+
+static struct {
+    EventSlot slots[EVENT_QUEUE_SIZE];
+    atomic_uint enqueue_pos;
+    uint32_t dequeue_pos;             // Kernel loop only
+    atomic_uint overflowed;           // Bit n set when a type-n event was dropped
+    atomic_uint posted;
+    atomic_uint overflows;
+    uint32_t delivered;
+    uint32_t high_water;
+    KernelEventHandler handlers[KERNEL_EVENT_COUNT];
+} event_queue;
+
+static struct {
+    atomic_bool sleeping;             // Set while the loop may block in kernel_wait
+    uint32_t input_poll_ms;
+    bool compacting;
+    size_t compact_moved;             // Bytes moved so far in this pass
+    uint32_t compact_settled;         // Fragmentation a pass could not reduce
+    KernelIdleStats idle;
+#if defined(__linux__)
+    int epoll_fd;
+    int event_fd;                     // Written by kernel_trigger_event
+    int timer_fd;                     // Armed with the next deadline
+    struct {
+        int fd;                       // -1 when the slot is free
+        KernelWakeFdHandler handler;
+        void* context;
+    } wake_fds[MAX_WAKE_FDS];
+#endif
+} kernel_state;
+
+static uint64_t kernel_now_us(void) {
+#if defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+#else
+    return (uint64_t)kernel_get_time() * 1000u;
+#endif
+}
+
+static void event_queue_init(void) {
+    for (uint32_t i = 0; i < EVENT_QUEUE_SIZE; i++) {
+        atomic_init(&event_queue.slots[i].sequence, i);
+    }
+    atomic_init(&event_queue.enqueue_pos, 0);
+    atomic_init(&event_queue.overflowed, 0);
+    atomic_init(&event_queue.posted, 0);
+    atomic_init(&event_queue.overflows, 0);
+    event_queue.dequeue_pos = 0;
+}
+
+static bool event_queue_push(const KernelEventRecord* event) {
+    uint32_t pos = atomic_load_explicit(&event_queue.enqueue_pos, memory_order_relaxed);
+    EventSlot* slot;
+    for (;;) {
+        slot = &event_queue.slots[pos & EVENT_QUEUE_MASK];
+        uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int32_t lap = (int32_t)(sequence - pos);
+        if (lap == 0) {
+            if (atomic_compare_exchange_weak_explicit(&event_queue.enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (lap < 0) {
+            return false; // Consumer is a full lap behind
+        } else {
+            pos = atomic_load_explicit(&event_queue.enqueue_pos, memory_order_relaxed);
+        }
+    }
+    slot->record = *event;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+static bool event_queue_pop(KernelEventRecord* event) {
+    EventSlot* slot = &event_queue.slots[event_queue.dequeue_pos & EVENT_QUEUE_MASK];
+    uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (sequence != event_queue.dequeue_pos + 1) return false;
+
+    *event = slot->record;
+    atomic_store_explicit(&slot->sequence, event_queue.dequeue_pos + EVENT_QUEUE_SIZE,
+                          memory_order_release);
+    event_queue.dequeue_pos++;
+    return true;
+}
+
+static bool event_queue_empty(void) {
+    const EventSlot* slot = &event_queue.slots[event_queue.dequeue_pos & EVENT_QUEUE_MASK];
+    return atomic_load_explicit(&slot->sequence, memory_order_acquire) != event_queue.dequeue_pos + 1 &&
+           atomic_load_explicit(&event_queue.overflowed, memory_order_acquire) == 0;
+}
+
+static void deliver_event(const KernelEventRecord* event) {
+    KernelEventHandler handler = event_queue.handlers[event->type];
+    if (handler) handler(event);
+    event_queue.delivered++;
+}
+
+// Hand up to one batch of queued events to their handlers. Types whose posts
+// overflowed are delivered once more, without payload, after the batch.
+static void drain_events(void) {
+    uint32_t queued = atomic_load_explicit(&event_queue.enqueue_pos, memory_order_relaxed) -
+                      event_queue.dequeue_pos;
+    if (queued > EVENT_QUEUE_SIZE) queued = EVENT_QUEUE_SIZE;
+    if (queued > event_queue.high_water) event_queue.high_water = queued;
+
+    KernelEventRecord event;
+    for (int i = 0; i < EVENT_BATCH_SIZE && event_queue_pop(&event); i++) {
+        deliver_event(&event);
+    }
+
+    uint32_t lost = atomic_exchange_explicit(&event_queue.overflowed, 0, memory_order_acquire);
+    while (lost) {
+        KernelEventRecord summary = { .type = (KernelEvent)__builtin_ctz(lost),
+                                      .timestamp = kernel_get_time() };
+        lost &= lost - 1;
+        deliver_event(&summary);
+    }
+}
+
+static void kernel_wake(void) {
+#if defined(__linux__)
+    // Only pay for the syscall when the loop may be asleep. Pairs with the
+    // fence in kernel_wait: either the loop sees the event or we see it sleeping.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_exchange(&kernel_state.sleeping, false)) {
+        uint64_t one = 1;
+        (void)write(kernel_state.event_fd, &one, sizeof(one));
+    }
+#endif
+}
+
+static void kernel_wait_init(void) {
+#if defined(__linux__)
+    kernel_state.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    kernel_state.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    kernel_state.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.fd = kernel_state.event_fd;
+    epoll_ctl(kernel_state.epoll_fd, EPOLL_CTL_ADD, kernel_state.event_fd, &ev);
+    ev.data.fd = kernel_state.timer_fd;
+    epoll_ctl(kernel_state.epoll_fd, EPOLL_CTL_ADD, kernel_state.timer_fd, &ev);
+
+    for (int i = 0; i < MAX_WAKE_FDS; i++) kernel_state.wake_fds[i].fd = -1;
+#endif
+}
+
+#if defined(__linux__)
+static int wake_fd_slot(int fd) {
+    for (int i = 0; i < MAX_WAKE_FDS; i++) {
+        if (kernel_state.wake_fds[i].fd == fd) return i;
+    }
+    return -1;
+}
+#endif
+
+// Block until an event, a registered fd or the timeout (in microseconds,
+// UINT64_MAX for none). Returns true if the timeout expired.
+static bool kernel_wait(uint64_t timeout_us) {
+#if defined(__linux__)
+    struct itimerspec when = { 0 };
+    if (timeout_us != UINT64_MAX) {
+        // A zero it_value would disarm the timer; wait at least 1 us
+        if (timeout_us == 0) timeout_us = 1;
+        when.it_value.tv_sec = (time_t)(timeout_us / 1000000u);
+        when.it_value.tv_nsec = (long)(timeout_us % 1000000u) * 1000;
+    }
+    timerfd_settime(kernel_state.timer_fd, 0, &when, NULL);
+
+    // Announce the sleep, then check for events posted before producers
+    // could see it
+    atomic_store(&kernel_state.sleeping, true);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!event_queue_empty()) {
+        atomic_store(&kernel_state.sleeping, false);
+        return false;
+    }
+
+    struct epoll_event ready[MAX_WAKE_FDS + 2];
+    int count = epoll_wait(kernel_state.epoll_fd, ready, MAX_WAKE_FDS + 2, -1);
+    atomic_store(&kernel_state.sleeping, false);
+
+    bool timed_out = false;
+    uint64_t drained;
+    for (int i = 0; i < count; i++) {
+        if (ready[i].data.fd == kernel_state.timer_fd) {
+            timed_out = read(kernel_state.timer_fd, &drained, sizeof(drained)) > 0;
+        } else if (ready[i].data.fd == kernel_state.event_fd) {
+            (void)read(kernel_state.event_fd, &drained, sizeof(drained));
+        } else {
+            // Looked up again in case an earlier handler removed it
+            int slot = wake_fd_slot(ready[i].data.fd);
+            if (slot >= 0) {
+                kernel_state.wake_fds[slot].handler(ready[i].data.fd,
+                                                    kernel_state.wake_fds[slot].context);
+            }
+        }
+    }
+    return timed_out && event_queue_empty();
+#else
+    // Wait for an interrupt until the deadline or a queued event. Posting
+    // ISRs wake the core, so no extra signal is needed.
+    uint64_t deadline = timeout_us == UINT64_MAX ? UINT64_MAX : kernel_now_us() + timeout_us;
+    while (event_queue_empty() && kernel_now_us() < deadline) {
+#if defined(__arm__) || defined(__aarch64__)
+        __asm__ volatile("wfi");
+#endif
+    }
+    return event_queue_empty();
+#endif
+}
 
 void kernel_init() {
     // Early Initialization
     display_init(); // Initialize display driver early for boot messages
     
+    // Event ring and wake fds first: subsystems may post events (memory
+    // pressure, for one) while they initialize
+    event_queue_init();
+    atomic_init(&kernel_state.sleeping, false);
+    kernel_state.input_poll_ms = DEFAULT_INPUT_POLL_MS;
+    kernel_state.compact_settled = UINT32_MAX;
+    kernel_wait_init();
+
     // Initialize Subsystems
-    memory_init();
+    hal_timer_init(); // Kernel time base
+    memory_init(MEMORY_ALLOC_POOL, POWER_MODE_NORMAL);
     process_init();
     ui_init();
     power_init(); // Initialize power management (if available)
@@ -23,24 +291,163 @@ void kernel_init() {
 }
 
 void kernel_main() {
-    // Main Kernel Loop
+    // Main Kernel Loop. Each pass does whatever is due, then sleeps until
+    // the next deadline or until an event arrives.
     while (1) {
+        uint64_t busy_start = kernel_now_us();
+        drain_events();
+
+        // Periodic real-time jobs first, and again after each long stage
+        scheduler_run_periodic();
+
         // Process Scheduling
         schedule_processes();
+        scheduler_run_periodic();
+
+        // Deferred app events, in bounded batches
+        app_dispatch_events(APP_EVENT_BATCH);
 
         // UI Management
         ui_draw();     // Update the UI
+        scheduler_run_periodic();
         ui_handle_input(); // Process user input (touchscreen, buttons)
 
-        // Power Management
+        // Timers and Power Management
+        hal_timer_dispatch();
         power_manage(); // Call periodically to adjust power settings
 
+        // Idle-time heap compaction in bounded slices, one pass at a time.
+        // Blocks without a handle cannot move, so after a pass that moved
+        // nothing wait for the fragmentation to change before another.
+        if (!kernel_state.compacting) {
+            uint32_t fragmentation = memory_get_extended_stats().fragmentation;
+            kernel_state.compacting = fragmentation >= DEFRAG_START_PERCENT &&
+                                      fragmentation != kernel_state.compact_settled;
+            kernel_state.compact_moved = 0;
+        }
+        if (kernel_state.compacting &&
+            memory_defragment_step(DEFRAG_SLICE_BYTES, &kernel_state.compact_moved)) {
+            kernel_state.compacting = false;
+            kernel_state.compact_settled = kernel_state.compact_moved ?
+                UINT32_MAX : memory_get_extended_stats().fragmentation;
+        }
+        memory_cache_expire();
+
         // Optional: Kernel-level Logging
         if (error_occurred()) {
             // Log error details to a file or the display (if available)
         }
 
-        // Yield CPU to avoid busy waiting (if possible on your platform)
-        // yield_cpu();
+        // Sleep until the nearest of: next periodic release, next hardware
+        // timer, next input poll. Don't sleep while work is still queued.
+        uint64_t timeout_us = scheduler_run_periodic();
+        if (timeout_us == UINT32_MAX) timeout_us = UINT64_MAX;
+        uint32_t timer_ms = hal_timer_next_expiry();
+        if (timer_ms != UINT32_MAX && (uint64_t)timer_ms * 1000u < timeout_us) {
+            timeout_us = (uint64_t)timer_ms * 1000u;
+        }
+        if (kernel_state.input_poll_ms && (uint64_t)kernel_state.input_poll_ms * 1000u < timeout_us) {
+            timeout_us = (uint64_t)kernel_state.input_poll_ms * 1000u;
+        }
+        if (process_has_ready() || app_events_pending() || kernel_state.compacting ||
+            !event_queue_empty()) {
+            timeout_us = 0;
+        }
+
+        uint64_t idle_start = kernel_now_us();
+        kernel_state.idle.busy_us += idle_start - busy_start;
+        if (timeout_us == 0) continue;
+
+        bool timed_out = kernel_wait(timeout_us);
+        kernel_state.idle.idle_us += kernel_now_us() - idle_start;
+        kernel_state.idle.wakeups++;
+        if (timed_out) kernel_state.idle.timeout_wakeups++;
+        else kernel_state.idle.event_wakeups++;
+    }
+}
+
+void kernel_trigger_event(KernelEvent event) {
+    KernelEventRecord record = { .type = event };
+    kernel_post_event(&record);
+}
+
+// Safe from any thread (SDL audio, worker pool, signal handlers)
+bool kernel_post_event(const KernelEventRecord* event) {
+    if (!event || event->type <= KERNEL_EVENT_NONE || event->type >= KERNEL_EVENT_COUNT) return false;
+
+    KernelEventRecord record = *event;
+    record.timestamp = kernel_get_time();
+
+    bool queued = event_queue_push(&record);
+    if (queued) {
+        atomic_fetch_add_explicit(&event_queue.posted, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&event_queue.overflows, 1, memory_order_relaxed);
+        atomic_fetch_or_explicit(&event_queue.overflowed, 1u << record.type, memory_order_release);
     }
+    kernel_wake();
+    return queued;
+}
+
+void kernel_set_event_handler(KernelEvent type, KernelEventHandler handler) {
+    if (type <= KERNEL_EVENT_NONE || type >= KERNEL_EVENT_COUNT) return;
+    event_queue.handlers[type] = handler;
+}
+
+KernelEventQueueStats kernel_get_event_queue_stats(void) {
+    KernelEventQueueStats stats = {
+        .posted = atomic_load_explicit(&event_queue.posted, memory_order_relaxed),
+        .delivered = event_queue.delivered,
+        .overflows = atomic_load_explicit(&event_queue.overflows, memory_order_relaxed),
+        .high_water = event_queue.high_water,
+    };
+    return stats;
+}
+
+uint32_t kernel_get_time() {
+    uint64_t uptime_ms;
+    if (hal_clock_get_uptime(&uptime_ms) != CLOCK_HAL_SUCCESS) return 0;
+    return (uint32_t)uptime_ms;
+}
+
+bool kernel_add_wake_fd(int fd, KernelWakeFdHandler handler, void* context) {
+#if defined(__linux__)
+    if (fd < 0 || !handler || wake_fd_slot(fd) >= 0) return false;
+    int slot = wake_fd_slot(-1);
+    if (slot < 0) return false;
+
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.fd = fd;
+    if (epoll_ctl(kernel_state.epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) return false;
+    kernel_state.wake_fds[slot].fd = fd;
+    kernel_state.wake_fds[slot].handler = handler;
+    kernel_state.wake_fds[slot].context = context;
+    return true;
+#else
+    (void)fd;
+    (void)handler;
+    (void)context;
+    return false;
+#endif
+}
+
+bool kernel_remove_wake_fd(int fd) {
+#if defined(__linux__)
+    int slot = fd < 0 ? -1 : wake_fd_slot(fd);
+    if (slot < 0) return false;
+    epoll_ctl(kernel_state.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    kernel_state.wake_fds[slot].fd = -1;
+    return true;
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+void kernel_set_input_poll_interval(uint32_t milliseconds) {
+    kernel_state.input_poll_ms = milliseconds;
+}
+
+KernelIdleStats kernel_get_idle_stats(void) {
+    return kernel_state.idle;
 }
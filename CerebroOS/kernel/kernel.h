@@ -2,6 +2,7 @@
 #define KERNEL_H
 
 #include <stdint.h> // For standard integer types (e.g., uint32_t)
+#include <stdbool.h>
 
 // --- Kernel Event Types (for improved modularity) ---
 
@@ -11,9 +12,35 @@ typedef enum {
     KERNEL_EVENT_UI_UPDATE,    // Trigger UI redraw
     KERNEL_EVENT_POWER_LOW,    // Low battery warning
     KERNEL_EVENT_TIMER_TICK,   // Periodic timer tick
+    KERNEL_EVENT_MEMORY_PRESSURE, // Memory pressure level changed
+    KERNEL_EVENT_AUDIO_BUFFER, // Audio device consumed a buffer
     // ... add more events as needed (e.g., network, sensor events)
+    KERNEL_EVENT_COUNT
 } KernelEvent;
 
+// An event with its payload, as posted to the kernel event queue
+typedef struct {
+    KernelEvent type;
+    uint32_t timestamp;         // kernel_get_time() when posted
+    union {
+        uint32_t value;         // Counts, levels, codes
+        int32_t delta;
+        struct { int16_t x, y; } point;
+        void* pointer;          // Must stay valid until the handler runs
+    } data;
+} KernelEventRecord;
+
+// Runs in the kernel loop for each drained event of its type
+typedef void (*KernelEventHandler)(const KernelEventRecord* event);
+
+// Event queue counters
+typedef struct {
+    uint32_t posted;
+    uint32_t delivered;
+    uint32_t overflows;         // Posts rejected because the queue was full
+    uint32_t high_water;        // Most events queued at once
+} KernelEventQueueStats;
+
 // --- Function Declarations ---
 
 // Initialize the kernel (memory, processes, UI, etc.)
@@ -22,9 +49,47 @@ void kernel_init();
 // Main kernel loop (runs continuously)
 void kernel_main();
 
-// Trigger a kernel event 
+// Trigger a kernel event. Safe to call from any thread; wakes the kernel
+// loop if it is idle.
 void kernel_trigger_event(KernelEvent event); 
 
+// Queue an event with a payload. Lock-free and allocation-free, so it may be
+// called from interrupt handlers, driver threads and apps alike. Returns
+// false if the queue is full; the event type is then still delivered once,
+// without its payload.
+bool kernel_post_event(const KernelEventRecord* event);
+
+// Set the handler for one event type (NULL to ignore it)
+void kernel_set_event_handler(KernelEvent type, KernelEventHandler handler);
+
+KernelEventQueueStats kernel_get_event_queue_stats(void);
+
+// Time the kernel loop spent sleeping versus working
+typedef struct {
+    uint64_t idle_us;
+    uint64_t busy_us;
+    uint32_t wakeups;
+    uint32_t timeout_wakeups;   // Woken by a deadline (timer, periodic task, input poll)
+    uint32_t event_wakeups;     // Woken by an event or a wake fd
+} KernelIdleStats;
+
+KernelIdleStats kernel_get_idle_stats(void);
+
+// Runs in the kernel loop while a wake fd is readable or hung up. Wake fds
+// are level-triggered, so it must read what is pending (or remove the fd)
+// or the loop will not go back to sleep.
+typedef void (*KernelWakeFdHandler)(int fd, void* context);
+
+// Also wake the idle kernel loop when this file descriptor becomes readable
+// (input devices, sockets), and hand it to the handler. Emulator only;
+// returns false elsewhere or when all MAX_WAKE_FDS slots are taken.
+bool kernel_add_wake_fd(int fd, KernelWakeFdHandler handler, void* context);
+bool kernel_remove_wake_fd(int fd);
+
+// Longest the loop sleeps while input must be polled. Pass 0 once all input
+// arrives through events or wake fds, for a fully tickless loop.
+void kernel_set_input_poll_interval(uint32_t milliseconds);
+
 // Optional Functions (add as needed)
 
 // Get the current kernel time in milliseconds
@@ -1,8 +1,18 @@
+#if defined(__linux__)
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS
+#endif
 #include "memory_manager.h"
+#include "memory_trace.h"
+#include "kernel.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 
 #define MEMORY_SIZE (1024 * 1024)  // 1 MB total memory
 #define POOL_SIZE (256 * 1024)     // 256 KB for each pool
@@ -12,48 +22,85 @@
 #define MEDIUM_BLOCK_SIZE 256
 #define MEMORY_ALIGNMENT 8
 #define CACHE_BLOCK_MAGIC 0xCAFEBABE
+#define CACHE_HASH_LOG 6           // Buckets for keyed cache lookup
+#define CACHE_NO_KEY 0             // Key of unkeyed (never evicted) cache blocks
 #define SYSTEM_RESERVE_SIZE (64 * 1024)  // 64KB reserved for system
 #define MIN_BLOCK_SIZE 16
 #define COMPRESSION_THRESHOLD 4096  // Minimum size for compression
+#define HEAP_BLOCK_MAGIC 0xB10CB10C
+#define MAX_MEMORY_HANDLES 256
+#define MAX_SHRINKERS 16
+#define MAX_TRACE_OWNERS 64
 
-typedef struct MemoryBlock {
-    size_t size;
-    bool free;
-    uint32_t access_count;
-    uint64_t last_access;
-    struct MemoryBlock* next;
-    struct MemoryBlock* prev;
-} MemoryBlock;
+// Large objects bypass the heap. Each one gets its own page-aligned span:
+// an anonymous mapping on the Linux emulator, or a run of pages from a
+// reserved region on device.
+#define LARGE_OBJECT_THRESHOLD (16 * 1024)
+#define LARGE_PAGE_SIZE 4096
+#define MAX_LARGE_SPANS 64
+#define LARGE_REGION_SIZE (1024 * 1024)
+#define LARGE_REGION_PAGES (LARGE_REGION_SIZE / LARGE_PAGE_SIZE)
+
+// Per-thread pool caches. Each thread keeps up to MAGAZINE_CAPACITY blocks
+// per size class and moves MAGAZINE_BATCH at a time to or from the shared
+// pools, so the depot lock is taken once per batch rather than per call.
+#define MAGAZINE_CAPACITY 32
+#define MAGAZINE_BATCH (MAGAZINE_CAPACITY / 2)
+
+// Pressure watermarks as percent of the heap still free. A level is left
+// only once free memory climbs PRESSURE_HYSTERESIS points above its mark.
+#define PRESSURE_MODERATE_FREE_PERCENT 25
+#define PRESSURE_HIGH_FREE_PERCENT 10
+#define PRESSURE_CRITICAL_FREE_PERCENT 5
+#define PRESSURE_HYSTERESIS 3
+
+// LZ77 byte codec for cache compression, using an LZ4-style sequence format:
+// a token (literal length : match length), literals, a 16-bit offset, and
+// 255-run length extensions for either field.
+#define LZ_HASH_LOG 12
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_LAST_LITERALS 5    // Trailing bytes always emitted as literals
+#define LZ_MATCH_LIMIT 12     // No match may start this close to the end
+
+// TLSF (two-level segregated fit) heap index. Free blocks are binned by the
+// power of two of their size (first level) and then by TLSF_SL_INDEX_COUNT
+// linear subdivisions of that range (second level). A bitmap per level lets
+// allocation find a non-empty bin with two bit scans instead of a list walk.
+#define TLSF_ALIGN_SIZE_LOG2 3
+#define TLSF_SL_INDEX_COUNT_LOG2 4
+#define TLSF_SL_INDEX_COUNT (1 << TLSF_SL_INDEX_COUNT_LOG2)
+#define TLSF_FL_INDEX_SHIFT (TLSF_SL_INDEX_COUNT_LOG2 + TLSF_ALIGN_SIZE_LOG2)
+#define TLSF_FL_INDEX_MAX 21  // Largest block class is [1 MB, 2 MB)
+#define TLSF_FL_INDEX_COUNT (TLSF_FL_INDEX_MAX - TLSF_FL_INDEX_SHIFT + 1)
+#define TLSF_SMALL_BLOCK_SIZE (1 << TLSF_FL_INDEX_SHIFT)
+#define TLSF_BLOCK_SIZE_MAX (((size_t)1 << TLSF_FL_INDEX_MAX) - 1)
+
+// Returned pool blocks are threaded through their own first word
+typedef struct PoolFreeBlock {
+    struct PoolFreeBlock* next;
+} PoolFreeBlock;
 
 typedef struct {
     void* blocks;
     size_t block_size;
     uint32_t total_blocks;
     uint32_t used_blocks;
-    bool* block_map;
+    uint32_t next_unused;       // Blocks from here on have never been handed out
+    PoolFreeBlock* free_stack;  // Blocks returned by memory_free
+    _Atomic uint64_t* used_map; // One bit per block, set while held by a caller
+    uint16_t* owners;           // Owner tag of each block, valid while its bit is set
 } MemoryPool;
 
-typedef enum {
-    MEMORY_ALLOC_POOL,
-    MEMORY_ALLOC_BEST_FIT
-} MemoryAllocationStrategy;
-
-typedef enum {
-    POWER_MODE_NORMAL,
-    POWER_MODE_LOW
-} PowerMode;
-
-typedef enum {
-    BLOCK_TYPE_TEMP,
-    BLOCK_TYPE_SYSTEM,
-    BLOCK_TYPE_CACHE
-} BlockType;
+typedef struct {
+    void* rounds[MAGAZINE_CAPACITY];
+    uint32_t count;
+} PoolMagazine;
 
-typedef enum {
-    PRESSURE_LOW,
-    PRESSURE_MEDIUM,
-    PRESSURE_HIGH
-} MemoryPressure;
+typedef struct {
+    PoolMagazine magazines[MAX_POOLS];
+    uint32_t generation;                  // Pool generation the rounds belong to
+} ThreadCache;
 
 typedef struct MemoryBlockHeader {
     size_t size;
@@ -64,52 +111,318 @@ typedef struct MemoryBlockHeader {
     bool is_free;
     bool can_relocate;
     uint8_t alignment;
-    struct MemoryBlockHeader* next;
-    struct MemoryBlockHeader* prev;
+    uint16_t owner;                       // Owner tag at allocation time
+    void** handle;                        // Owning handle slot if relocatable
+    struct MemoryBlockHeader* next_free;  // Segregated free list links
+    struct MemoryBlockHeader* prev_free;
 } MemoryBlockHeader;
 
+// Boundary tag at the end of every heap block. It mirrors the header size
+// so a block can find its physical predecessor without a stored pointer.
+typedef struct {
+    size_t size;
+} BlockFooter;
+
+#define BLOCK_OVERHEAD (sizeof(MemoryBlockHeader) + sizeof(BlockFooter))
+
+typedef struct {
+    MemoryShrinkCallback callback;
+    void* context;
+    uint8_t priority;
+} Shrinker;
+
+// Arenas grow by chaining chunks; allocation bumps `used` in the head chunk
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t capacity;
+    size_t used;
+    uint8_t data[];
+} ArenaChunk;
+
+struct MemoryArena {
+    ArenaChunk* head;
+    size_t chunk_size;
+};
+
+typedef struct {
+    uint8_t* base;        // Page aligned; this is the pointer handed out
+    size_t size;          // Whole pages
+    uint16_t owner;
+} LargeSpan;
+
+// Keyed cache blocks sit on an LRU list (most recent first) and in a hash
+// chain; unkeyed blocks are on neither
 typedef struct CacheBlock {
     uint32_t magic;
+    uint32_t key;
     size_t original_size;
     size_t compressed_size;
     uint32_t last_access;
     bool is_compressed;
+    struct CacheBlock* lru_prev;
+    struct CacheBlock* lru_next;
+    struct CacheBlock* hash_next;
     uint8_t* data;
 } CacheBlock;
 
-typedef struct MemoryConfig {
-    bool enable_compression;
-    float defrag_threshold;
-} MemoryConfig;
-
-typedef struct MemoryStats {
-    uint32_t total_memory;
-    uint32_t used_memory;
-    uint32_t free_memory;
-    uint32_t allocation_count;
-    float fragmentation;
-} MemoryStats;
-
 static struct {
-    MemoryBlock* heap_head;
     MemoryPool pools[MAX_POOLS];
+    atomic_flag depot_lock;               // Guards the pools' free stacks
+    uint32_t pool_generation;             // Bumped on init to drop stale caches
     MemoryAllocationStrategy strategy;
     PowerMode power_mode;
-    MemoryStats stats;
+    MemoryUsageStats stats;
     MemoryBlockHeader* heap_start;
+    uint8_t* heap_base;
+    size_t heap_size;
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[TLSF_FL_INDEX_COUNT];
+    MemoryBlockHeader* free_lists[TLSF_FL_INDEX_COUNT][TLSF_SL_INDEX_COUNT];
+    void* handle_table[MAX_MEMORY_HANDLES];
+    void** handle_free;                   // Unused slots, chained through themselves
+    MemoryBlockHeader* defrag_cursor;     // Where the next compaction slice resumes
+    Shrinker shrinkers[MAX_SHRINKERS];    // Sorted by ascending priority
+    uint8_t shrinker_count;
+    uint16_t current_owner;
+    struct {
+        TraceRecord* records;             // NULL while tracing is off
+        size_t capacity;
+        size_t head;
+        size_t count;
+        uint32_t dropped;
+        TraceOwnerName owners[MAX_TRACE_OWNERS];
+        uint16_t owner_count;
+    } trace;
+    MemoryPressure pressure;
+    MemoryPressure reclaimed_at;          // Level the last reclaim pass ran for
+    bool reclaiming;
     MemoryConfig config;
     MemoryStats mm_stats;
     bool is_low_power;
     uint8_t* compression_buffer;
     size_t compression_buffer_size;
+    CacheBlock* cache_buckets[1 << CACHE_HASH_LOG];
+    CacheBlock* cache_mru;
+    CacheBlock* cache_lru;
+    LargeSpan large_spans[MAX_LARGE_SPANS];
+    uint8_t large_span_count;
+#if !defined(__linux__)
+    uint32_t large_page_map[LARGE_REGION_PAGES / 32];  // Set bits are pages in use
+#endif
 } memory_manager;
 
+#if !defined(__linux__)
+static uint8_t large_region[LARGE_REGION_SIZE] __attribute__((aligned(LARGE_PAGE_SIZE)));
+#endif
+
+static _Thread_local ThreadCache thread_cache;
+
+static MemoryBlockHeader* find_free_block(size_t size);
+static uint32_t heap_fragmentation(void);
+static void* compress_block(void* data, size_t size, size_t* compressed_size);
+static void* decompress_block(void* data, size_t compressed_size, size_t original_size);
+static void update_memory_pressure(void);
+static void* heap_allocate(size_t size, BlockType type, uint8_t alignment, bool can_relocate);
+static void* large_allocate(size_t size);
+static LargeSpan* large_span_find(const void* ptr);
+static void large_free(LargeSpan* span);
+static size_t large_live_bytes(void);
+static size_t cache_shrink(MemoryPressure pressure, void* context);
+static void trace_record(TraceOp op, const void* ptr, size_t size, uint8_t type, const void* site);
+static size_t lz_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_capacity);
+
+static inline int tlsf_fls(size_t x) {
+    return x ? (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl((unsigned long)x) : -1;
+}
+
+static inline int tlsf_ffs(uint32_t x) {
+    return x ? __builtin_ctz(x) : -1;
+}
+
+// Map a block size to the bin that holds blocks of exactly that class
+static void tlsf_mapping_insert(size_t size, int* fl, int* sl) {
+    if (size < TLSF_SMALL_BLOCK_SIZE) {
+        *fl = 0;
+        *sl = (int)(size / (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_INDEX_COUNT));
+    } else {
+        int f = tlsf_fls(size);
+        *sl = (int)(size >> (f - TLSF_SL_INDEX_COUNT_LOG2)) ^ TLSF_SL_INDEX_COUNT;
+        *fl = f - (TLSF_FL_INDEX_SHIFT - 1);
+    }
+}
+
+// Map a request to the first bin whose blocks are all large enough for it
+static void tlsf_mapping_search(size_t size, int* fl, int* sl) {
+    if (size >= TLSF_SMALL_BLOCK_SIZE) {
+        size += ((size_t)1 << (tlsf_fls(size) - TLSF_SL_INDEX_COUNT_LOG2)) - 1;
+    }
+    tlsf_mapping_insert(size, fl, sl);
+}
+
+static void block_insert(MemoryBlockHeader* block) {
+    int fl, sl;
+    tlsf_mapping_insert(block->size, &fl, &sl);
+
+    MemoryBlockHeader* head = memory_manager.free_lists[fl][sl];
+    block->next_free = head;
+    block->prev_free = NULL;
+    if (head) head->prev_free = block;
+    memory_manager.free_lists[fl][sl] = block;
+
+    memory_manager.fl_bitmap |= 1u << fl;
+    memory_manager.sl_bitmap[fl] |= 1u << sl;
+}
+
+static void block_remove(MemoryBlockHeader* block) {
+    int fl, sl;
+    tlsf_mapping_insert(block->size, &fl, &sl);
+
+    if (block->prev_free) block->prev_free->next_free = block->next_free;
+    else memory_manager.free_lists[fl][sl] = block->next_free;
+    if (block->next_free) block->next_free->prev_free = block->prev_free;
+    block->next_free = NULL;
+    block->prev_free = NULL;
+
+    if (!memory_manager.free_lists[fl][sl]) {
+        memory_manager.sl_bitmap[fl] &= ~(1u << sl);
+        if (!memory_manager.sl_bitmap[fl]) {
+            memory_manager.fl_bitmap &= ~(1u << fl);
+        }
+    }
+}
+
+static inline BlockFooter* block_footer(MemoryBlockHeader* block) {
+    return (BlockFooter*)((uint8_t*)block + sizeof(MemoryBlockHeader) + block->size);
+}
+
+static inline void block_set_size(MemoryBlockHeader* block, size_t size) {
+    block->size = size;
+    block_footer(block)->size = size;
+}
+
+// Physical neighbours are derived from the boundary tags
+static inline MemoryBlockHeader* block_next(MemoryBlockHeader* block) {
+    uint8_t* next = (uint8_t*)block + BLOCK_OVERHEAD + block->size;
+    if (next >= memory_manager.heap_base + memory_manager.heap_size) return NULL;
+    return (MemoryBlockHeader*)next;
+}
+
+static inline MemoryBlockHeader* block_prev(MemoryBlockHeader* block) {
+    if ((uint8_t*)block == memory_manager.heap_base) return NULL;
+    BlockFooter* footer = (BlockFooter*)((uint8_t*)block - sizeof(BlockFooter));
+    return (MemoryBlockHeader*)((uint8_t*)footer - footer->size - sizeof(MemoryBlockHeader));
+}
+
+// Carve `size` bytes off the front of a block. Returns the remainder, which
+// the caller must file as free, or NULL if the block was too small to split.
+static MemoryBlockHeader* block_split(MemoryBlockHeader* block, size_t size) {
+    if (block->size <= size + BLOCK_OVERHEAD + MIN_BLOCK_SIZE) return NULL;
+
+    size_t rest_size = block->size - size - BLOCK_OVERHEAD;
+    block_set_size(block, size);
+
+    MemoryBlockHeader* rest = (MemoryBlockHeader*)((uint8_t*)block + BLOCK_OVERHEAD + size);
+    rest->type = BLOCK_TYPE_TEMP;
+    rest->magic = HEAP_BLOCK_MAGIC;
+    rest->is_free = true;
+    rest->can_relocate = true;
+    rest->handle = NULL;
+    block_set_size(rest, rest_size);
+    return rest;
+}
+
+// Merge a free block with its free physical neighbours and file the result.
+// The boundary tags make both neighbours reachable in constant time.
+static MemoryBlockHeader* block_release(MemoryBlockHeader* block) {
+    MemoryBlockHeader* next = block_next(block);
+    if (next && next->is_free) {
+        block_remove(next);
+        block_set_size(block, block->size + next->size + BLOCK_OVERHEAD);
+        if (memory_manager.defrag_cursor == next) memory_manager.defrag_cursor = block;
+    }
+
+    MemoryBlockHeader* prev = block_prev(block);
+    if (prev && prev->is_free) {
+        block_remove(prev);
+        if (memory_manager.defrag_cursor == block) memory_manager.defrag_cursor = prev;
+        block_set_size(prev, prev->size + block->size + BLOCK_OVERHEAD);
+        block = prev;
+    }
+
+    block_insert(block);
+    return block;
+}
+
+static void heap_init(size_t size) {
+    // Reuse the region of an earlier init when it is the right size
+    if (memory_manager.heap_base && memory_manager.heap_size != size) {
+        free(memory_manager.heap_base);
+        memory_manager.heap_base = NULL;
+    }
+    if (!memory_manager.heap_base) {
+        memory_manager.heap_base = malloc(size);
+    } else {
+        memset(memory_manager.heap_base, 0, size);  // Stale headers must not pass as live blocks
+    }
+    memory_manager.heap_size = size;
+    memory_manager.fl_bitmap = 0;
+    memset(memory_manager.sl_bitmap, 0, sizeof(memory_manager.sl_bitmap));
+    memset(memory_manager.free_lists, 0, sizeof(memory_manager.free_lists));
+
+    MemoryBlockHeader* block = (MemoryBlockHeader*)memory_manager.heap_base;
+    block->type = BLOCK_TYPE_SYSTEM;
+    block->magic = HEAP_BLOCK_MAGIC;
+    block->is_free = true;
+    block->can_relocate = false;
+    block->handle = NULL;
+    block_set_size(block, size - BLOCK_OVERHEAD);
+    memory_manager.heap_start = block;
+    memory_manager.defrag_cursor = NULL;
+    memory_manager.pressure = PRESSURE_NORMAL;
+    memory_manager.reclaimed_at = PRESSURE_NORMAL;
+    block_insert(block);
+
+    // Chain all handle slots into the free list
+    for (int i = 0; i < MAX_MEMORY_HANDLES - 1; i++) {
+        memory_manager.handle_table[i] = &memory_manager.handle_table[i + 1];
+    }
+    memory_manager.handle_table[MAX_MEMORY_HANDLES - 1] = NULL;
+    memory_manager.handle_free = &memory_manager.handle_table[0];
+    
+    // Cache entries lived in the old heap; keyed ones are the first to go
+    // under pressure
+    memset(memory_manager.cache_buckets, 0, sizeof(memory_manager.cache_buckets));
+    memory_manager.cache_mru = NULL;
+    memory_manager.cache_lru = NULL;
+    memory_unregister_shrinker(cache_shrink, NULL);
+    memory_register_shrinker(cache_shrink, NULL, 0);
+}
+
+// Move heap bytes between the used and free totals
+static void heap_adjust_usage(ptrdiff_t delta) {
+    memory_manager.stats.used_memory += delta;
+    memory_manager.mm_stats.used_memory += delta;
+    memory_manager.mm_stats.free_memory -= delta;
+}
+
 static void init_pool(MemoryPool* pool, size_t block_size, size_t total_size) {
+    size_t map_words = (total_size / block_size + 63) / 64;
+    if (pool->blocks && pool->block_size == block_size && pool->total_blocks == total_size / block_size) {
+        // Same geometry as the last init: keep the buffers, forget the blocks
+        memset((void*)pool->used_map, 0, map_words * sizeof(uint64_t));
+    } else {
+        free(pool->blocks);
+        free((void*)pool->used_map);
+        free(pool->owners);
+        pool->blocks = malloc(total_size);
+        pool->used_map = calloc(map_words, sizeof(uint64_t));
+        pool->owners = calloc(total_size / block_size, sizeof(uint16_t));
+    }
     pool->block_size = block_size;
     pool->total_blocks = total_size / block_size;
     pool->used_blocks = 0;
-    pool->blocks = malloc(total_size);
-    pool->block_map = calloc(pool->total_blocks, sizeof(bool));
+    pool->next_unused = 0;
+    pool->free_stack = NULL;
 }
 
 void memory_init(MemoryAllocationStrategy strategy, PowerMode power_mode) {
@@ -120,141 +433,298 @@ void memory_init(MemoryAllocationStrategy strategy, PowerMode power_mode) {
     init_pool(&memory_manager.pools[0], TINY_BLOCK_SIZE, POOL_SIZE);
     init_pool(&memory_manager.pools[1], SMALL_BLOCK_SIZE, POOL_SIZE);
     init_pool(&memory_manager.pools[2], MEDIUM_BLOCK_SIZE, POOL_SIZE);
+    atomic_flag_clear(&memory_manager.depot_lock);
+    memory_manager.pool_generation++;
     
-    // Initialize heap
-    memory_manager.heap_head = malloc(sizeof(MemoryBlock));
-    memory_manager.heap_head->size = MEMORY_SIZE - (3 * POOL_SIZE);
-    memory_manager.heap_head->free = true;
-    memory_manager.heap_head->next = NULL;
-    memory_manager.heap_head->prev = NULL;
+    // Initialize heap with whatever the pools leave over
+    heap_init(MEMORY_SIZE - (MAX_POOLS * POOL_SIZE));
     
-    // Initialize stats
-    memset(&memory_manager.stats, 0, sizeof(MemoryStats));
+    // Initialize stats. Large spans outlive a re-init: they are not carved
+    // from the heap or pools, and their owners may still hold them.
+    memset(&memory_manager.stats, 0, sizeof(MemoryUsageStats));
     memory_manager.stats.total_memory = MEMORY_SIZE;
+    memory_manager.stats.used_memory = large_live_bytes();
     
     // Initialize memory manager context
-    memset(&memory_manager.heap_start, 0, sizeof(MemoryBlockHeader*));
     memset(&memory_manager.config, 0, sizeof(MemoryConfig));
     memset(&memory_manager.mm_stats, 0, sizeof(MemoryStats));
+    memory_manager.mm_stats.total_memory = MEMORY_SIZE;
+    memory_manager.mm_stats.free_memory = memory_manager.heap_start->size;
     memory_manager.is_low_power = false;
+    free(memory_manager.compression_buffer);
     memory_manager.compression_buffer = NULL;
     memory_manager.compression_buffer_size = 0;
 }
 
-static void* allocate_from_pool(size_t size) {
-    MemoryPool* pool = NULL;
-    
-    if (size <= TINY_BLOCK_SIZE) pool = &memory_manager.pools[0];
-    else if (size <= SMALL_BLOCK_SIZE) pool = &memory_manager.pools[1];
-    else if (size <= MEDIUM_BLOCK_SIZE) pool = &memory_manager.pools[2];
-    else return NULL;
+// Header of the heap block a pointer was handed out for, or NULL if the
+// pointer is outside the heap (a stale span, say) or has no valid header
+static MemoryBlockHeader* heap_block_from_ptr(void* ptr) {
+    uint8_t* heap_end = memory_manager.heap_base + memory_manager.heap_size;
+    if ((uint8_t*)ptr < memory_manager.heap_base + sizeof(MemoryBlockHeader) || (uint8_t*)ptr >= heap_end) {
+        return NULL;
+    }
     
+    MemoryBlockHeader* block = (MemoryBlockHeader*)((uint8_t*)ptr - sizeof(MemoryBlockHeader));
+    return block->magic == HEAP_BLOCK_MAGIC ? block : NULL;
+}
+
+static MemoryPool* pool_for_size(size_t size) {
+    if (size <= TINY_BLOCK_SIZE) return &memory_manager.pools[0];
+    if (size <= SMALL_BLOCK_SIZE) return &memory_manager.pools[1];
+    if (size <= MEDIUM_BLOCK_SIZE) return &memory_manager.pools[2];
+    return NULL;
+}
+
+// Find the pool that owns a pointer, or NULL if it came from the heap
+static MemoryPool* pool_from_ptr(const void* ptr) {
+    for (int i = 0; i < MAX_POOLS; i++) {
+        MemoryPool* pool = &memory_manager.pools[i];
+        const uint8_t* base = pool->blocks;
+        if ((const uint8_t*)ptr >= base &&
+            (const uint8_t*)ptr < base + pool->total_blocks * pool->block_size) {
+            return pool;
+        }
+    }
+    return NULL;
+}
+
+static inline void depot_lock(void) {
+    while (atomic_flag_test_and_set_explicit(&memory_manager.depot_lock, memory_order_acquire)) {
+        // Spin; critical sections are a few dozen pointer moves
+    }
+}
+
+static inline void depot_unlock(void) {
+    atomic_flag_clear_explicit(&memory_manager.depot_lock, memory_order_release);
+}
+
+// Take one block from the shared pool. Caller holds the depot lock.
+static void* depot_take(MemoryPool* pool) {
     if (pool->used_blocks >= pool->total_blocks) return NULL;
     
-    // Find first free block
-    for (uint32_t i = 0; i < pool->total_blocks; i++) {
-        if (!pool->block_map[i]) {
-            pool->block_map[i] = true;
-            pool->used_blocks++;
-            memory_manager.stats.pool_usage[pool - memory_manager.pools] += pool->block_size;
-            return (char*)pool->blocks + (i * pool->block_size);
-        }
+    // Reuse a returned block first, otherwise hand out a fresh one
+    uint8_t* block;
+    if (pool->free_stack) {
+        block = (uint8_t*)pool->free_stack;
+        pool->free_stack = pool->free_stack->next;
+    } else {
+        block = (uint8_t*)pool->blocks + (size_t)pool->next_unused++ * pool->block_size;
     }
     
-    return NULL;
+    pool->used_blocks++;
+    memory_manager.stats.pool_usage[pool - memory_manager.pools] += pool->block_size;
+    return block;
 }
 
-void* memory_allocate(size_t size) {
-    if (memory_manager.strategy == MEMORY_ALLOC_POOL) {
-        void* pool_alloc = allocate_from_pool(size);
-        if (pool_alloc) return pool_alloc;
+// Return one block to the shared pool. Caller holds the depot lock.
+static void depot_return(MemoryPool* pool, void* ptr) {
+    PoolFreeBlock* block = ptr;
+    block->next = pool->free_stack;
+    pool->free_stack = block;
+    pool->used_blocks--;
+    memory_manager.stats.pool_usage[pool - memory_manager.pools] -= pool->block_size;
+}
+
+static PoolMagazine* thread_magazine(MemoryPool* pool) {
+    if (thread_cache.generation != memory_manager.pool_generation) {
+        memset(&thread_cache, 0, sizeof(thread_cache));
+        thread_cache.generation = memory_manager.pool_generation;
     }
+    return &thread_cache.magazines[pool - memory_manager.pools];
+}
+
+static inline uint32_t pool_block_index(const MemoryPool* pool, const void* ptr) {
+    return (uint32_t)(((const uint8_t*)ptr - (const uint8_t*)pool->blocks) / pool->block_size);
+}
+
+// Whether a pointer is the start of a pool block currently held by a caller
+static bool pool_block_live(const MemoryPool* pool, const void* ptr) {
+    size_t offset = (size_t)((const uint8_t*)ptr - (const uint8_t*)pool->blocks);
+    if (offset % pool->block_size != 0) return false;
     
-    // Fall back to heap allocation if pool allocation fails
-    MemoryBlock* current = memory_manager.heap_head;
-    MemoryBlock* best_fit = NULL;
-    size_t min_size_diff = SIZE_MAX;
+    uint32_t index = pool_block_index(pool, ptr);
+    uint64_t word = atomic_load_explicit(&pool->used_map[index / 64], memory_order_relaxed);
+    return (word >> (index % 64)) & 1;
+}
+
+// Set or clear a block's used bit. Returns false if it already had that
+// state; the atomic swap makes this hold even for racing frees on two
+// threads. Blocks in the depot and in magazines are all clear.
+static bool pool_mark_used(MemoryPool* pool, const void* ptr, bool used) {
+    uint32_t index = pool_block_index(pool, ptr);
+    uint64_t bit = (uint64_t)1 << (index % 64);
+    if (used) {
+        return !(atomic_fetch_or_explicit(&pool->used_map[index / 64], bit, memory_order_relaxed) & bit);
+    }
+    return (atomic_fetch_and_explicit(&pool->used_map[index / 64], ~bit, memory_order_relaxed) & bit) != 0;
+}
+
+static void* allocate_from_pool(size_t size) {
+    MemoryPool* pool = pool_for_size(size);
+    if (!pool) return NULL;
     
-    while (current) {
-        if (current->free && current->size >= size) {
-            if (memory_manager.strategy == MEMORY_ALLOC_BEST_FIT) {
-                size_t size_diff = current->size - size;
-                if (size_diff < min_size_diff) {
-                    min_size_diff = size_diff;
-                    best_fit = current;
-                }
-            } else {
-                best_fit = current;
-                break;
-            }
+    // Refill an empty magazine with a batch from the depot
+    PoolMagazine* magazine = thread_magazine(pool);
+    if (magazine->count == 0) {
+        depot_lock();
+        while (magazine->count < MAGAZINE_BATCH) {
+            void* block = depot_take(pool);
+            if (!block) break;
+            magazine->rounds[magazine->count++] = block;
         }
-        current = current->next;
+        depot_unlock();
+        if (magazine->count == 0) return NULL;
     }
     
-    if (!best_fit) return NULL;
-    
-    // Split block if necessary
-    if (best_fit->size > size + sizeof(MemoryBlock) + 32) {
-        MemoryBlock* new_block = (MemoryBlock*)((char*)best_fit + sizeof(MemoryBlock) + size);
-        new_block->size = best_fit->size - size - sizeof(MemoryBlock);
-        new_block->free = true;
-        new_block->next = best_fit->next;
-        new_block->prev = best_fit;
-        if (best_fit->next) best_fit->next->prev = new_block;
-        best_fit->next = new_block;
-        best_fit->size = size;
+    void* block = magazine->rounds[--magazine->count];
+    pool_mark_used(pool, block, true);
+    pool->owners[pool_block_index(pool, block)] = memory_manager.current_owner;
+    return block;
+}
+
+// Cache a block the caller has already released with pool_mark_used
+static void free_to_pool(MemoryPool* pool, void* ptr) {
+    // Flush the coldest half of a full magazine back to the depot
+    PoolMagazine* magazine = thread_magazine(pool);
+    if (magazine->count == MAGAZINE_CAPACITY) {
+        depot_lock();
+        for (uint32_t i = 0; i < MAGAZINE_BATCH; i++) {
+            depot_return(pool, magazine->rounds[i]);
+        }
+        depot_unlock();
+        memmove(magazine->rounds, magazine->rounds + MAGAZINE_BATCH,
+                (MAGAZINE_CAPACITY - MAGAZINE_BATCH) * sizeof(void*));
+        magazine->count -= MAGAZINE_BATCH;
     }
     
-    best_fit->free = false;
-    best_fit->access_count = 0;
-    best_fit->last_access = 0; // TODO: Add timestamp
+    magazine->rounds[magazine->count++] = ptr;
+}
+
+void memory_flush_thread_cache(void) {
+    if (thread_cache.generation != memory_manager.pool_generation) return;
     
-    memory_manager.stats.used_memory += size;
-    if (memory_manager.stats.used_memory > memory_manager.stats.peak_usage) {
-        memory_manager.stats.peak_usage = memory_manager.stats.used_memory;
+    depot_lock();
+    for (int i = 0; i < MAX_POOLS; i++) {
+        PoolMagazine* magazine = &thread_cache.magazines[i];
+        while (magazine->count > 0) {
+            depot_return(&memory_manager.pools[i], magazine->rounds[--magazine->count]);
+        }
+    }
+    depot_unlock();
+}
+
+void* memory_allocate(size_t size) {
+    if (size > LARGE_OBJECT_THRESHOLD) {
+        void* large = large_allocate(size);
+        if (large) {
+            trace_record(TRACE_OP_ALLOC, large, size, BLOCK_TYPE_APP, __builtin_return_address(0));
+            return large;
+        }
     }
     
-    return (char*)best_fit + sizeof(MemoryBlock);
+    if (memory_manager.strategy == MEMORY_ALLOC_POOL) {
+        void* pool_alloc = allocate_from_pool(size);
+        if (pool_alloc) {
+            trace_record(TRACE_OP_ALLOC, pool_alloc, size, 0xFF, __builtin_return_address(0));
+            return pool_alloc;
+        }
+    }
+    
+    // Fall back to heap allocation if pool allocation fails. First fit and
+    // best fit are both served by the TLSF index, which returns a good fit
+    // in constant time regardless of how fragmented the heap is.
+    void* ptr = heap_allocate(size, BLOCK_TYPE_APP, MEMORY_ALIGNMENT, false);
+    trace_record(TRACE_OP_ALLOC, ptr, size, BLOCK_TYPE_APP, __builtin_return_address(0));
+    return ptr;
 }
 
 void memory_free(void* ptr) {
     if (ptr == NULL) return;
     
-    MemoryBlock* block = (MemoryBlock*)((char*)ptr - sizeof(MemoryBlock));
-    block->free = true;
+    // Pool blocks carry no header; they are identified by address range
+    MemoryPool* pool = pool_from_ptr(ptr);
+    if (pool) {
+        // Only a block held by a caller may be cached: a double free would
+        // otherwise sit in a magazine twice and be handed out twice
+        size_t offset = (size_t)((uint8_t*)ptr - (uint8_t*)pool->blocks);
+        if (offset % pool->block_size != 0 || !pool_mark_used(pool, ptr, false)) return;
+        trace_record(TRACE_OP_FREE, ptr, pool->block_size, 0xFF, __builtin_return_address(0));
+        free_to_pool(pool, ptr);
+        return;
+    }
     
-    // Coalesce adjacent free blocks
-    MemoryBlock* current = memory_manager.heap_head;
-    while (current != NULL) {
-        if (current->free && current->next && current->next->free) {
-            current->size += current->next->size + sizeof(MemoryBlock);
-            current->next = current->next->next;
-            continue; // Check the new 'next' block
-        }
-        current = current->next;
+    // Check spans before reading a header: a span has nothing mapped in front
+    LargeSpan* span = large_span_find(ptr);
+    if (span) {
+        trace_record(TRACE_OP_FREE, ptr, span->size, BLOCK_TYPE_APP, __builtin_return_address(0));
+        large_free(span);
+        return;
     }
+    
+    MemoryBlockHeader* block = heap_block_from_ptr(ptr);
+    if (!block || block->is_free) return;
+    trace_record(TRACE_OP_FREE, ptr, block->size, block->type, __builtin_return_address(0));
+    block->is_free = true;
+    block->handle = NULL;
+    
+    // Update stats
+    memory_manager.stats.used_memory -= block->size;
+    memory_manager.mm_stats.used_memory -= block->size + BLOCK_OVERHEAD;
+    memory_manager.mm_stats.free_memory += block->size + BLOCK_OVERHEAD;
+    if (block->type == BLOCK_TYPE_TEMP) memory_manager.mm_stats.temp_memory -= block->size;
+    
+    // Coalesce with physical neighbours and return to the free lists
+    block_release(block);
+    update_memory_pressure();
+}
+
+size_t memory_usable_size(void* ptr) {
+    if (ptr == NULL) return 0;
+    
+    MemoryPool* pool = pool_from_ptr(ptr);
+    if (pool) return pool_block_live(pool, ptr) ? pool->block_size : 0;
+    
+    LargeSpan* span = large_span_find(ptr);
+    if (span) return span->size;
+    
+    MemoryBlockHeader* block = heap_block_from_ptr(ptr);
+    if (!block || block->is_free) return 0;
+    return block->size;
+}
+
+uint16_t memory_get_owner(void* ptr) {
+    if (ptr == NULL) return 0;
+    
+    MemoryPool* pool = pool_from_ptr(ptr);
+    if (pool) return pool_block_live(pool, ptr) ? pool->owners[pool_block_index(pool, ptr)] : 0;
+    
+    LargeSpan* span = large_span_find(ptr);
+    if (span) return span->owner;
+    
+    MemoryBlockHeader* block = heap_block_from_ptr(ptr);
+    if (!block || block->is_free) return 0;
+    return block->owner;
 }
 
 void memory_init_ex(const MemoryConfig* config) {
     // Initialize memory manager context
-    memset(&memory_manager.heap_start, 0, sizeof(MemoryBlockHeader*));
     memcpy(&memory_manager.config, config, sizeof(MemoryConfig));
     
     // Allocate initial heap
-    memory_manager.heap_start = (MemoryBlockHeader*)malloc(MEMORY_SIZE);
-    memory_manager.heap_start->size = MEMORY_SIZE - sizeof(MemoryBlockHeader);
-    memory_manager.heap_start->type = BLOCK_TYPE_SYSTEM;
-    memory_manager.heap_start->is_free = true;
-    memory_manager.heap_start->can_relocate = false;
-    memory_manager.heap_start->next = NULL;
-    memory_manager.heap_start->prev = NULL;
+    heap_init(MEMORY_SIZE);
     
     // Initialize stats
+    memset(&memory_manager.stats, 0, sizeof(MemoryUsageStats));
+    memory_manager.stats.total_memory = MEMORY_SIZE;
+    memory_manager.stats.used_memory = large_live_bytes();  // Spans survive, as in memory_init
     memset(&memory_manager.mm_stats, 0, sizeof(MemoryStats));
     memory_manager.mm_stats.total_memory = MEMORY_SIZE;
     memory_manager.mm_stats.free_memory = memory_manager.heap_start->size;
     
     // Allocate compression buffer if enabled
+    free(memory_manager.compression_buffer);
+    memory_manager.compression_buffer = NULL;
+    memory_manager.compression_buffer_size = 0;
     if (config->enable_compression) {
         memory_manager.compression_buffer_size = MEMORY_SIZE / 4;  // 25% of total memory
         memory_manager.compression_buffer = malloc(memory_manager.compression_buffer_size);
@@ -265,70 +735,162 @@ void memory_init_ex(const MemoryConfig* config) {
 }
 
 void* memory_allocate_ex(size_t size, BlockType type, uint8_t alignment, bool can_relocate) {
+    // Only plain app data may leave the heap; the other block types rely on
+    // heap headers for accounting, compaction or cache bookkeeping
+    void* ptr = NULL;
+    if (size > LARGE_OBJECT_THRESHOLD && type == BLOCK_TYPE_APP && !can_relocate) {
+        ptr = large_allocate(size);
+    }
+    if (!ptr) ptr = heap_allocate(size, type, alignment, can_relocate);
+    trace_record(TRACE_OP_ALLOC, ptr, size, type, __builtin_return_address(0));
+    return ptr;
+}
+
+static void* heap_allocate(size_t size, BlockType type, uint8_t alignment, bool can_relocate) {
     if (size == 0) return NULL;
     
     // Adjust size for alignment
-    size = (size + (alignment - 1)) & ~(alignment - 1);
+    if (alignment < MEMORY_ALIGNMENT) alignment = MEMORY_ALIGNMENT;
+    size = (size + (alignment - 1)) & ~(size_t)(alignment - 1);
+    if (size < MIN_BLOCK_SIZE) size = MIN_BLOCK_SIZE;
+    if (size > TLSF_BLOCK_SIZE_MAX) return NULL;
     
     // Check memory pressure
     MemoryPressure pressure = memory_get_pressure();
-    if (pressure >= PRESSURE_HIGH && type != BLOCK_TYPE_SYSTEM) {
+    if (pressure >= PRESSURE_HIGH && pressure > memory_manager.reclaimed_at && type != BLOCK_TYPE_SYSTEM) {
         memory_handle_pressure(pressure);
     }
     
-    // Find best fit block
-    MemoryBlockHeader* block = find_best_fit(size, type);
+    // Find a free block from the segregated lists
+    MemoryBlockHeader* block = find_free_block(size);
     if (!block) {
         // Try to free up memory
         memory_optimize();
-        block = find_best_fit(size, type);
+        block = find_free_block(size);
         if (!block) return NULL;
     }
+    block_remove(block);
     
-    // Split block if too large
-    if (block->size > size + sizeof(MemoryBlockHeader) + MIN_BLOCK_SIZE) {
-        MemoryBlockHeader* new_block = (MemoryBlockHeader*)((uint8_t*)block + sizeof(MemoryBlockHeader) + size);
-        new_block->size = block->size - size - sizeof(MemoryBlockHeader);
-        new_block->type = BLOCK_TYPE_TEMP;
-        new_block->is_free = true;
-        new_block->can_relocate = true;
-        new_block->next = block->next;
-        new_block->prev = block;
-        if (block->next) block->next->prev = new_block;
-        block->next = new_block;
-        block->size = size;
-    }
+    // Split block if too large. Free blocks never border each other, so
+    // the remainder can be filed without another merge.
+    MemoryBlockHeader* rest = block_split(block, size);
+    if (rest) block_insert(rest);
     
     // Initialize block
     block->type = type;
     block->is_free = false;
     block->can_relocate = can_relocate;
+    block->handle = NULL;
     block->alignment = alignment;
-    block->last_access = 0;  // TODO: Add timestamp
+    block->owner = memory_manager.current_owner;
+    block->last_access = kernel_get_time();
     block->access_count = 0;
     
     // Update stats
-    memory_manager.mm_stats.used_memory += block->size + sizeof(MemoryBlockHeader);
-    memory_manager.mm_stats.free_memory -= block->size + sizeof(MemoryBlockHeader);
+    memory_manager.mm_stats.used_memory += block->size + BLOCK_OVERHEAD;
+    memory_manager.mm_stats.free_memory -= block->size + BLOCK_OVERHEAD;
     memory_manager.mm_stats.allocation_count++;
+    if (type == BLOCK_TYPE_TEMP) memory_manager.mm_stats.temp_memory += block->size;
+    memory_manager.stats.used_memory += block->size;
+    memory_manager.stats.allocation_count++;
+    if (memory_manager.stats.used_memory > memory_manager.stats.peak_usage) {
+        memory_manager.stats.peak_usage = memory_manager.stats.used_memory;
+    }
+    update_memory_pressure();
     
     return (uint8_t*)block + sizeof(MemoryBlockHeader);
 }
 
-void memory_free_ex(void* ptr) {
-    if (!ptr) return;
+// Get whole pages for a span, or NULL if none are available
+static void* span_map(size_t size) {
+#if defined(__linux__)
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return base == MAP_FAILED ? NULL : base;
+#else
+    // First fit over the page map of the reserved region
+    size_t pages = size / LARGE_PAGE_SIZE;
+    size_t run = 0;
+    for (size_t page = 0; page < LARGE_REGION_PAGES; page++) {
+        if (memory_manager.large_page_map[page / 32] & (1u << (page % 32))) {
+            run = 0;
+            continue;
+        }
+        if (++run == pages) {
+            size_t first = page + 1 - pages;
+            for (size_t i = first; i <= page; i++) {
+                memory_manager.large_page_map[i / 32] |= 1u << (i % 32);
+            }
+            return large_region + first * LARGE_PAGE_SIZE;
+        }
+    }
+    return NULL;
+#endif
+}
+
+static void span_unmap(void* base, size_t size) {
+#if defined(__linux__)
+    munmap(base, size);
+#else
+    size_t first = (size_t)((uint8_t*)base - large_region) / LARGE_PAGE_SIZE;
+    for (size_t i = first; i < first + size / LARGE_PAGE_SIZE; i++) {
+        memory_manager.large_page_map[i / 32] &= ~(1u << (i % 32));
+    }
+#endif
+}
+
+static void* large_allocate(size_t size) {
+    if (memory_manager.large_span_count >= MAX_LARGE_SPANS) return NULL;
     
-    MemoryBlockHeader* block = (MemoryBlockHeader*)((uint8_t*)ptr - sizeof(MemoryBlockHeader));
-    block->is_free = true;
+    size = (size + LARGE_PAGE_SIZE - 1) & ~(size_t)(LARGE_PAGE_SIZE - 1);
+    uint8_t* base = span_map(size);
+    if (!base) return NULL;
     
-    // Update stats
-    memory_manager.mm_stats.used_memory -= block->size + sizeof(MemoryBlockHeader);
-    memory_manager.mm_stats.free_memory += block->size + sizeof(MemoryBlockHeader);
+    LargeSpan* span = &memory_manager.large_spans[memory_manager.large_span_count++];
+    span->base = base;
+    span->size = size;
+    span->owner = memory_manager.current_owner;
+    
+    memory_manager.stats.used_memory += size;
+    memory_manager.stats.allocation_count++;
+    if (memory_manager.stats.used_memory > memory_manager.stats.peak_usage) {
+        memory_manager.stats.peak_usage = memory_manager.stats.used_memory;
+    }
+    return base;
+}
+
+static LargeSpan* large_span_find(const void* ptr) {
+    // Spans always start on a page boundary; most pointers are rejected here
+    if ((uintptr_t)ptr & (LARGE_PAGE_SIZE - 1)) return NULL;
+    
+    for (uint8_t i = 0; i < memory_manager.large_span_count; i++) {
+        if (memory_manager.large_spans[i].base == ptr) return &memory_manager.large_spans[i];
+    }
+    return NULL;
+}
+
+static void large_free(LargeSpan* span) {
+    span_unmap(span->base, span->size);
+    memory_manager.stats.used_memory -= span->size;
+    
+    // Keep the table dense by moving the last span into the hole
+    *span = memory_manager.large_spans[--memory_manager.large_span_count];
+}
+
+static size_t large_live_bytes(void) {
+    size_t total = 0;
+    for (uint8_t i = 0; i < memory_manager.large_span_count; i++) {
+        total += memory_manager.large_spans[i].size;
+    }
+    return total;
+}
+
+void memory_free_ex(void* ptr) {
+    if (!ptr) return;
     
-    // Coalesce free blocks
-    coalesce_free_blocks();
+    memory_free(ptr);
     
     // Check if we should optimize memory
+    memory_manager.mm_stats.fragmentation = heap_fragmentation();
     if (memory_manager.mm_stats.fragmentation > memory_manager.config.defrag_threshold) {
         memory_optimize();
     }
@@ -348,6 +910,237 @@ void memory_optimize(void) {
     update_memory_pressure();
 }
 
+static CacheBlock* cache_from_ptr(void* ptr) {
+    if (!ptr) return NULL;
+    CacheBlock* cache = (CacheBlock*)ptr - 1;
+    return cache->magic == CACHE_BLOCK_MAGIC ? cache : NULL;
+}
+
+static inline MemoryBlockHeader* cache_block_header(CacheBlock* cache) {
+    return (MemoryBlockHeader*)((uint8_t*)cache - sizeof(MemoryBlockHeader));
+}
+
+static inline size_t cache_block_size(size_t data_size) {
+    return (sizeof(CacheBlock) + data_size + (MEMORY_ALIGNMENT - 1)) & ~(size_t)(MEMORY_ALIGNMENT - 1);
+}
+
+static inline CacheBlock** cache_bucket(uint32_t key) {
+    return &memory_manager.cache_buckets[(key * 2654435761u) >> (32 - CACHE_HASH_LOG)];
+}
+
+static void cache_lru_unlink(CacheBlock* cache) {
+    if (cache->lru_prev) cache->lru_prev->lru_next = cache->lru_next;
+    else memory_manager.cache_mru = cache->lru_next;
+    if (cache->lru_next) cache->lru_next->lru_prev = cache->lru_prev;
+    else memory_manager.cache_lru = cache->lru_prev;
+}
+
+static void cache_lru_push(CacheBlock* cache) {
+    cache->lru_prev = NULL;
+    cache->lru_next = memory_manager.cache_mru;
+    if (memory_manager.cache_mru) memory_manager.cache_mru->lru_prev = cache;
+    else memory_manager.cache_lru = cache;
+    memory_manager.cache_mru = cache;
+}
+
+static CacheBlock* cache_find(uint32_t key) {
+    CacheBlock* cache = *cache_bucket(key);
+    while (cache && cache->key != key) cache = cache->hash_next;
+    return cache;
+}
+
+// Take a keyed block off the LRU list and out of the index
+static void cache_unlink(CacheBlock* cache) {
+    if (cache->key == CACHE_NO_KEY) return;
+    
+    cache_lru_unlink(cache);
+    CacheBlock** link = cache_bucket(cache->key);
+    while (*link != cache) link = &(*link)->hash_next;
+    *link = cache->hash_next;
+}
+
+// Free an already unlinked block
+static void cache_release(CacheBlock* cache) {
+    memory_manager.mm_stats.cache_memory -= cache_block_header(cache)->size;
+    cache->magic = 0;
+    memory_free(cache);
+}
+
+static void cache_destroy(CacheBlock* cache) {
+    cache_unlink(cache);
+    cache_release(cache);
+}
+
+// Evict oldest entries until the tier fits cache_limit, sparing `keep`
+static void cache_trim(CacheBlock* keep) {
+    size_t limit = memory_manager.config.cache_limit;
+    while (limit && memory_manager.mm_stats.cache_memory > limit &&
+           memory_manager.cache_lru && memory_manager.cache_lru != keep) {
+        cache_destroy(memory_manager.cache_lru);
+    }
+}
+
+static CacheBlock* cache_create(size_t size, uint32_t key) {
+    if (size == 0) return NULL;
+    
+    // Make room under cache_limit, then under heap exhaustion, oldest first
+    size_t limit = memory_manager.config.cache_limit;
+    size_t needed = cache_block_size(size);
+    while (limit && memory_manager.cache_lru && memory_manager.mm_stats.cache_memory + needed > limit) {
+        cache_destroy(memory_manager.cache_lru);
+    }
+    if (limit && memory_manager.mm_stats.cache_memory + needed > limit) return NULL;
+    
+    CacheBlock* cache = memory_allocate_ex(sizeof(CacheBlock) + size, BLOCK_TYPE_CACHE, MEMORY_ALIGNMENT, false);
+    while (!cache && memory_manager.cache_lru) {
+        cache_destroy(memory_manager.cache_lru);
+        cache = memory_allocate_ex(sizeof(CacheBlock) + size, BLOCK_TYPE_CACHE, MEMORY_ALIGNMENT, false);
+    }
+    if (!cache) return NULL;
+    
+    cache->magic = CACHE_BLOCK_MAGIC;
+    cache->key = key;
+    cache->original_size = size;
+    cache->compressed_size = 0;
+    cache->last_access = kernel_get_time();
+    cache->is_compressed = false;
+    cache->data = (uint8_t*)(cache + 1);
+    memory_manager.mm_stats.cache_memory += cache_block_header(cache)->size;
+    
+    if (key != CACHE_NO_KEY) {
+        CacheBlock** bucket = cache_bucket(key);
+        cache->hash_next = *bucket;
+        *bucket = cache;
+        cache_lru_push(cache);
+    }
+    
+    // The heap may have handed out a little more than asked for
+    cache_trim(cache);
+    return cache;
+}
+
+void* memory_cache_alloc(size_t size) {
+    CacheBlock* cache = cache_create(size, CACHE_NO_KEY);
+    return cache ? cache->data : NULL;
+}
+
+void memory_cache_free(void* ptr) {
+    CacheBlock* cache = cache_from_ptr(ptr);
+    if (!cache) return;
+    
+    cache_destroy(cache);
+}
+
+void* memory_cache_insert(uint32_t key, size_t size) {
+    if (key == CACHE_NO_KEY) return NULL;
+    
+    CacheBlock* old = cache_find(key);
+    if (old) cache_destroy(old);
+    
+    CacheBlock* cache = cache_create(size, key);
+    return cache ? cache->data : NULL;
+}
+
+void* memory_cache_lookup(uint32_t key) {
+    CacheBlock* cache = key != CACHE_NO_KEY ? cache_find(key) : NULL;
+    void* data = cache ? memory_cache_access(cache->data) : NULL;
+    
+    if (data) memory_manager.mm_stats.cache_hits++;
+    else memory_manager.mm_stats.cache_misses++;
+    return data;
+}
+
+void memory_cache_clear(void) {
+    while (memory_manager.cache_lru) {
+        cache_destroy(memory_manager.cache_lru);
+    }
+}
+
+void memory_cache_expire(void) {
+    uint32_t ttl = memory_manager.config.cache_ttl;
+    if (ttl == 0) return;
+    
+    // The LRU tail is always the longest idle entry
+    uint32_t now = kernel_get_time();
+    while (memory_manager.cache_lru && now - memory_manager.cache_lru->last_access >= ttl) {
+        cache_destroy(memory_manager.cache_lru);
+    }
+}
+
+// Built-in shrinker: keyed cache entries are the cheapest memory to give back
+static size_t cache_shrink(MemoryPressure pressure, void* context) {
+    (void)context;
+    size_t before = memory_manager.mm_stats.cache_memory;
+    
+    memory_cache_expire();
+    if (pressure >= PRESSURE_CRITICAL) {
+        memory_cache_clear();
+    } else {
+        size_t target = pressure >= PRESSURE_HIGH ? before / 2 : before - before / 4;
+        while (memory_manager.cache_lru && memory_manager.mm_stats.cache_memory > target) {
+            cache_destroy(memory_manager.cache_lru);
+        }
+    }
+    return before - memory_manager.mm_stats.cache_memory;
+}
+
+void* memory_cache_access(void* ptr) {
+    CacheBlock* cache = cache_from_ptr(ptr);
+    if (!cache) return NULL;
+    
+    MemoryBlockHeader* block = cache_block_header(cache);
+    block->access_count++;
+    block->last_access = kernel_get_time();
+    cache->last_access = block->last_access;
+    if (cache->key != CACHE_NO_KEY) {
+        cache_lru_unlink(cache);
+        cache_lru_push(cache);
+    }
+    if (!cache->is_compressed) return cache->data;
+    
+    // Grow back in place when the following block is free and big enough
+    size_t needed = cache_block_size(cache->original_size);
+    MemoryBlockHeader* next = block_next(block);
+    if (next && next->is_free && block->size + BLOCK_OVERHEAD + next->size >= needed) {
+        void* plain = decompress_block(cache->data, cache->compressed_size, cache->original_size);
+        if (!plain) {
+            cache_destroy(cache);
+            return NULL;
+        }
+        
+        size_t old_size = block->size;
+        block_remove(next);
+        if (memory_manager.defrag_cursor == next) memory_manager.defrag_cursor = block;
+        heap_adjust_usage(next->size + BLOCK_OVERHEAD);
+        block_set_size(block, block->size + BLOCK_OVERHEAD + next->size);
+        
+        MemoryBlockHeader* rest = block_split(block, needed);
+        if (rest) {
+            heap_adjust_usage(-(ptrdiff_t)(rest->size + BLOCK_OVERHEAD));
+            block_insert(rest);
+        }
+        memory_manager.mm_stats.cache_memory += block->size - old_size;
+        
+        memcpy(cache->data, plain, cache->original_size);
+        cache->is_compressed = false;
+        cache->compressed_size = 0;
+        cache_trim(cache);
+        return cache->data;
+    }
+    
+    // Otherwise decompress into a fresh block under the same key. The old
+    // entry is unlinked first so making room cannot evict it mid-copy.
+    cache_unlink(cache);
+    CacheBlock* fresh = cache_create(cache->original_size, cache->key);
+    if (!fresh || lz_decompress(cache->data, cache->compressed_size, fresh->data, cache->original_size) != cache->original_size) {
+        if (fresh) cache_destroy(fresh);
+        cache_release(cache);
+        return NULL;
+    }
+    cache_release(cache);
+    return fresh->data;
+}
+
 void memory_compact_cache(void) {
     MemoryBlockHeader* block = memory_manager.heap_start;
     
@@ -356,98 +1149,590 @@ void memory_compact_cache(void) {
             CacheBlock* cache = (CacheBlock*)((uint8_t*)block + sizeof(MemoryBlockHeader));
             
             // Check if block should be compressed
-            if (!cache->is_compressed && block->size >= COMPRESSION_THRESHOLD) {
+            if (cache->magic == CACHE_BLOCK_MAGIC && !cache->is_compressed &&
+                cache->original_size >= COMPRESSION_THRESHOLD) {
                 size_t compressed_size;
                 void* compressed_data = compress_block(cache->data, cache->original_size, &compressed_size);
                 
-                if (compressed_data && compressed_size < cache->original_size) {
-                    // Replace with compressed data
-                    free(cache->data);
-                    cache->data = compressed_data;
+                if (compressed_data) {
+                    // Replace with compressed data in place
+                    memcpy(cache->data, compressed_data, compressed_size);
                     cache->compressed_size = compressed_size;
                     cache->is_compressed = true;
                     
-                    // Update block size
-                    size_t saved = block->size - compressed_size;
-                    block->size = compressed_size;
-                    
-                    // Create new free block with saved space
-                    MemoryBlockHeader* new_block = (MemoryBlockHeader*)((uint8_t*)block + sizeof(MemoryBlockHeader) + compressed_size);
-                    new_block->size = saved - sizeof(MemoryBlockHeader);
-                    new_block->type = BLOCK_TYPE_TEMP;
-                    new_block->is_free = true;
-                    new_block->can_relocate = true;
-                    new_block->next = block->next;
-                    new_block->prev = block;
-                    if (block->next) block->next->prev = new_block;
-                    block->next = new_block;
+                    // Give the saved space back to the heap
+                    MemoryBlockHeader* rest = block_split(block, cache_block_size(compressed_size));
+                    if (rest) {
+                        heap_adjust_usage(-(ptrdiff_t)(rest->size + BLOCK_OVERHEAD));
+                        memory_manager.mm_stats.cache_memory -= rest->size + BLOCK_OVERHEAD;
+                        block = block_release(rest);
+                    }
                 }
             }
         }
-        block = block->next;
+        block = block_next(block);
     }
 }
 
-static void* compress_block(void* data, size_t size, size_t* compressed_size) {
-    // Implement compression algorithm here
-    return NULL;
+static inline uint32_t lz_read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
 }
 
-static void* decompress_block(void* data, size_t compressed_size, size_t original_size) {
-    // Implement decompression algorithm here
-    return NULL;
+static inline uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+static uint8_t* lz_put_length(uint8_t* op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t)length;
+    return op;
 }
 
-static void coalesce_free_blocks(void) {
-    MemoryBlockHeader* current = memory_manager.heap_start;
+// Greedy single-probe LZ compressor. Returns the compressed size, or 0 if
+// the output would not fit in dst_capacity.
+static size_t lz_compress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_capacity) {
+    static uint32_t table[1 << LZ_HASH_LOG];
+    memset(table, 0, sizeof(table));
     
-    while (current != NULL) {
-        if (current->is_free && current->next && current->next->is_free) {
-            current->size += current->next->size + sizeof(MemoryBlockHeader);
-            current->next = current->next->next;
-            continue; // Check the new 'next' block
+    const uint8_t* ip = src;
+    const uint8_t* anchor = src;
+    const uint8_t* iend = src + src_size;
+    const uint8_t* mflimit = src_size > LZ_MATCH_LIMIT ? iend - LZ_MATCH_LIMIT : src;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dst_capacity;
+    
+    while (ip < mflimit) {
+        uint32_t sequence = lz_read32(ip);
+        uint32_t h = lz_hash(sequence);
+        const uint8_t* ref = src + table[h];
+        table[h] = (uint32_t)(ip - src);
+        
+        if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lz_read32(ref) != sequence) {
+            ip++;
+            continue;
+        }
+        
+        // Extend the match forward
+        const uint8_t* mp = ip + LZ_MIN_MATCH;
+        const uint8_t* rp = ref + LZ_MIN_MATCH;
+        while (mp < iend - LZ_LAST_LITERALS && *mp == *rp) {
+            mp++;
+            rp++;
         }
-        current = current->next;
+        
+        size_t literals = (size_t)(ip - anchor);
+        size_t match = (size_t)(mp - ip) - LZ_MIN_MATCH;
+        size_t offset = (size_t)(ip - ref);
+        if ((size_t)(oend - op) < 1 + literals + literals / 255 + 1 + 2 + match / 255 + 1) return 0;
+        
+        uint8_t* token = op++;
+        *token = (uint8_t)(((literals >= 15 ? 15 : literals) << 4) | (match >= 15 ? 15 : match));
+        if (literals >= 15) op = lz_put_length(op, literals - 15);
+        memcpy(op, anchor, literals);
+        op += literals;
+        *op++ = (uint8_t)offset;
+        *op++ = (uint8_t)(offset >> 8);
+        if (match >= 15) op = lz_put_length(op, match - 15);
+        
+        ip = mp;
+        anchor = ip;
     }
+    
+    // Final run of literals
+    size_t literals = (size_t)(iend - anchor);
+    if ((size_t)(oend - op) < 1 + literals + literals / 255 + 1) return 0;
+    *op++ = (uint8_t)((literals >= 15 ? 15 : literals) << 4);
+    if (literals >= 15) op = lz_put_length(op, literals - 15);
+    memcpy(op, anchor, literals);
+    op += literals;
+    
+    return (size_t)(op - dst);
+}
+
+// Returns the decompressed size, or 0 if the input is malformed or would
+// overflow dst_capacity.
+static size_t lz_decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_capacity) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + src_size;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dst_capacity;
+    
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return 0;
+                b = *ip++;
+                literals += b;
+            } while (b == 255);
+        }
+        if (literals > (size_t)(iend - ip) || literals > (size_t)(oend - op)) return 0;
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        
+        // The last sequence carries literals only
+        if (ip >= iend) break;
+        
+        if (iend - ip < 2) return 0;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) return 0;
+        
+        size_t match = token & 15;
+        if (match == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return 0;
+                b = *ip++;
+                match += b;
+            } while (b == 255);
+        }
+        match += LZ_MIN_MATCH;
+        if (match > (size_t)(oend - op)) return 0;
+        
+        // Byte copy so overlapping matches replicate correctly
+        const uint8_t* ref = op - offset;
+        while (match--) *op++ = *ref++;
+    }
+    
+    return (size_t)(op - dst);
+}
+
+// Compress into the shared compression buffer. Returns the buffer, or NULL
+// if the data does not shrink.
+static void* compress_block(void* data, size_t size, size_t* compressed_size) {
+    if (!memory_manager.compression_buffer) return NULL;
+    
+    size_t capacity = size - 1;
+    if (capacity > memory_manager.compression_buffer_size) {
+        capacity = memory_manager.compression_buffer_size;
+    }
+    
+    *compressed_size = lz_compress(data, size, memory_manager.compression_buffer, capacity);
+    return *compressed_size ? memory_manager.compression_buffer : NULL;
+}
+
+// Decompress into the shared compression buffer
+static void* decompress_block(void* data, size_t compressed_size, size_t original_size) {
+    if (!memory_manager.compression_buffer || original_size > memory_manager.compression_buffer_size) return NULL;
+    
+    if (lz_decompress(data, compressed_size, memory_manager.compression_buffer, original_size) != original_size) {
+        return NULL;
+    }
+    return memory_manager.compression_buffer;
+}
+
+static MemoryPressure pressure_for_free_percent(uint32_t free_percent, uint32_t margin) {
+    if (free_percent < PRESSURE_CRITICAL_FREE_PERCENT + margin) return PRESSURE_CRITICAL;
+    if (free_percent < PRESSURE_HIGH_FREE_PERCENT + margin) return PRESSURE_HIGH;
+    if (free_percent < PRESSURE_MODERATE_FREE_PERCENT + margin) return PRESSURE_MODERATE;
+    return PRESSURE_NORMAL;
 }
 
 static void update_memory_pressure(void) {
-    // Implement memory pressure update logic here
+    if (memory_manager.heap_size == 0) return;
+    
+    uint32_t free_percent = (uint32_t)((uint64_t)memory_manager.mm_stats.free_memory * 100 / memory_manager.heap_size);
+    MemoryPressure level = pressure_for_free_percent(free_percent, 0);
+    
+    // Rising pressure applies at once; falling pressure needs some headroom
+    if (level < memory_manager.pressure) {
+        level = pressure_for_free_percent(free_percent, PRESSURE_HYSTERESIS);
+        if (level > memory_manager.pressure) level = memory_manager.pressure;
+    }
+    
+    if (level != memory_manager.pressure) {
+        memory_manager.pressure = level;
+        if (level < memory_manager.reclaimed_at) memory_manager.reclaimed_at = level;
+        KernelEventRecord event = { .type = KERNEL_EVENT_MEMORY_PRESSURE, .data.value = level };
+        kernel_post_event(&event);
+    }
 }
 
-static MemoryBlockHeader* find_best_fit(size_t size, BlockType type) {
-    MemoryBlockHeader* best_fit = NULL;
-    size_t min_size_diff = SIZE_MAX;
+static MemoryBlockHeader* find_free_block(size_t size) {
+    int fl, sl;
+    tlsf_mapping_search(size, &fl, &sl);
+    if (fl >= TLSF_FL_INDEX_COUNT) return NULL;
     
-    MemoryBlockHeader* current = memory_manager.heap_start;
+    // Look for a non-empty list in this class, then in any larger class
+    uint32_t sl_map = memory_manager.sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        uint32_t fl_map = memory_manager.fl_bitmap & (~0u << (fl + 1));
+        if (!fl_map) return NULL;
+        
+        fl = tlsf_ffs(fl_map);
+        sl_map = memory_manager.sl_bitmap[fl];
+    }
+    sl = tlsf_ffs(sl_map);
     
-    while (current != NULL) {
-        if (current->is_free && current->size >= size) {
-            size_t size_diff = current->size - size;
-            if (size_diff < min_size_diff) {
-                min_size_diff = size_diff;
-                best_fit = current;
-            }
+    return memory_manager.free_lists[fl][sl];
+}
+
+// Share of free heap bytes that are not in the largest free block, in
+// percent. 0 means all free space is contiguous.
+static uint32_t heap_fragmentation(void) {
+    size_t free_bytes = memory_manager.mm_stats.free_memory;
+    if (!memory_manager.fl_bitmap || free_bytes == 0) return 0;
+    
+    // The largest free block lives in the highest non-empty first-level class
+    int fl = tlsf_fls(memory_manager.fl_bitmap);
+    size_t largest = 0;
+    for (int sl = 0; sl < TLSF_SL_INDEX_COUNT; sl++) {
+        for (MemoryBlockHeader* block = memory_manager.free_lists[fl][sl]; block; block = block->next_free) {
+            if (block->size + BLOCK_OVERHEAD > largest) largest = block->size + BLOCK_OVERHEAD;
         }
-        current = current->next;
     }
-    
-    return best_fit;
+    if (largest >= free_bytes) return 0;
+    return (uint32_t)((free_bytes - largest) * 100 / free_bytes);
+}
+
+MemoryUsageStats memory_get_stats(void) {
+    MemoryUsageStats stats = memory_manager.stats;
+    stats.fragmentation_percent = (float)heap_fragmentation();
+    return stats;
+}
+
+MemoryStats memory_get_extended_stats(void) {
+    memory_manager.mm_stats.fragmentation = heap_fragmentation();
+    return memory_manager.mm_stats;
 }
 
 MemoryPressure memory_get_pressure(void) {
-    // Implement memory pressure calculation logic here
-    return PRESSURE_LOW;
+    return memory_manager.pressure;
 }
 
 void memory_handle_pressure(MemoryPressure pressure) {
-    // Implement memory pressure handling logic here
+    // Shrinkers may free (or allocate) memory themselves; don't recurse
+    if (memory_manager.reclaiming || pressure == PRESSURE_NORMAL) return;
+    memory_manager.reclaiming = true;
+    memory_manager.reclaimed_at = pressure;
+    
+    // Compressing cold cache entries is the cheapest reclaim
+    memory_compact_cache();
+    
+    // Then ask subsystems to shed memory, cheapest first, until the level drops
+    for (uint8_t i = 0; i < memory_manager.shrinker_count; i++) {
+        if (memory_manager.pressure < pressure) break;
+        Shrinker* shrinker = &memory_manager.shrinkers[i];
+        shrinker->callback(memory_manager.pressure, shrinker->context);
+    }
+    
+    // As a last resort, close gaps so large requests can be served
+    if (memory_manager.pressure >= PRESSURE_CRITICAL) {
+        memory_defragment();
+    }
+    
+    memory_manager.reclaiming = false;
+}
+
+bool memory_register_shrinker(MemoryShrinkCallback callback, void* context, uint8_t priority) {
+    if (!callback || memory_manager.shrinker_count >= MAX_SHRINKERS) return false;
+    
+    // Keep the table sorted; equal priorities run in registration order
+    uint8_t i = memory_manager.shrinker_count;
+    while (i > 0 && memory_manager.shrinkers[i - 1].priority > priority) {
+        memory_manager.shrinkers[i] = memory_manager.shrinkers[i - 1];
+        i--;
+    }
+    memory_manager.shrinkers[i].callback = callback;
+    memory_manager.shrinkers[i].context = context;
+    memory_manager.shrinkers[i].priority = priority;
+    memory_manager.shrinker_count++;
+    return true;
+}
+
+void memory_unregister_shrinker(MemoryShrinkCallback callback, void* context) {
+    for (uint8_t i = 0; i < memory_manager.shrinker_count; i++) {
+        Shrinker* shrinker = &memory_manager.shrinkers[i];
+        if (shrinker->callback == callback && shrinker->context == context) {
+            memmove(shrinker, shrinker + 1, (memory_manager.shrinker_count - i - 1) * sizeof(Shrinker));
+            memory_manager.shrinker_count--;
+            return;
+        }
+    }
+}
+
+MemoryHandle memory_handle_alloc(size_t size, BlockType type) {
+    void** slot = memory_manager.handle_free;
+    if (!slot) return NULL;
+    
+    void* ptr = memory_allocate_ex(size, type, MEMORY_ALIGNMENT, true);
+    if (!ptr) return NULL;
+    
+    memory_manager.handle_free = *slot;
+    *slot = ptr;
+    ((MemoryBlockHeader*)((uint8_t*)ptr - sizeof(MemoryBlockHeader)))->handle = slot;
+    return slot;
+}
+
+void memory_handle_free(MemoryHandle handle) {
+    if (!handle) return;
+    
+    memory_free(*handle);
+    *handle = memory_manager.handle_free;
+    memory_manager.handle_free = handle;
+}
+
+// Slide relocatable blocks toward the heap start so free space collects
+// behind them. Work resumes where the previous slice stopped; a slice ends
+// after roughly `max_bytes` of copying and block visits.
+bool memory_defragment_step(size_t max_bytes, size_t* moved_bytes) {
+    MemoryBlockHeader* block = memory_manager.defrag_cursor;
+    if (!block) block = memory_manager.heap_start;
+    memory_manager.defrag_cursor = NULL;
+    
+    size_t budget = max_bytes;
+    while (block && budget > 0) {
+        MemoryBlockHeader* next = block_next(block);
+        
+        // Only a free gap followed by a handle-owned block can be closed
+        if (!block->is_free || !next || !next->can_relocate || !next->handle) {
+            budget -= budget < sizeof(MemoryBlockHeader) ? budget : sizeof(MemoryBlockHeader);
+            block = next;
+            continue;
+        }
+        
+        size_t gap = block->size + BLOCK_OVERHEAD;
+        size_t moved = next->size + BLOCK_OVERHEAD;
+        block_remove(block);
+        memmove(block, next, moved);
+        *block->handle = (uint8_t*)block + sizeof(MemoryBlockHeader);
+        
+        // The gap now sits after the moved block; merge it forward
+        MemoryBlockHeader* hole = (MemoryBlockHeader*)((uint8_t*)block + moved);
+        hole->type = BLOCK_TYPE_TEMP;
+        hole->magic = HEAP_BLOCK_MAGIC;
+        hole->is_free = true;
+        hole->can_relocate = true;
+        hole->handle = NULL;
+        block_set_size(hole, gap - BLOCK_OVERHEAD);
+        block = block_release(hole);
+        
+        budget -= budget < moved ? budget : moved;
+        if (moved_bytes) *moved_bytes += moved;
+    }
+    
+    memory_manager.defrag_cursor = block;
+    return block == NULL;
 }
 
 void memory_defragment(void) {
-    // Implement memory defragmentation logic here
+    // Run a full pass from the start of the heap
+    memory_manager.defrag_cursor = NULL;
+    memory_defragment_step(SIZE_MAX, NULL);
 }
 
 void memory_trim_unused(void) {
     // Implement memory trimming logic here
 }
+
+static ArenaChunk* arena_chunk_create(size_t capacity) {
+    // Respect the configured budget for temporary memory
+    size_t limit = memory_manager.config.temp_limit;
+    if (limit && memory_manager.mm_stats.temp_memory + sizeof(ArenaChunk) + capacity > limit) return NULL;
+    
+    ArenaChunk* chunk = memory_allocate_ex(sizeof(ArenaChunk) + capacity, BLOCK_TYPE_TEMP, MEMORY_ALIGNMENT, false);
+    if (!chunk) return NULL;
+    
+    chunk->next = NULL;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    return chunk;
+}
+
+MemoryArena* memory_arena_create(size_t chunk_size) {
+    MemoryArena* arena = memory_allocate(sizeof(MemoryArena));
+    if (!arena) return NULL;
+    
+    arena->chunk_size = chunk_size;
+    arena->head = arena_chunk_create(chunk_size);
+    if (!arena->head) {
+        memory_free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+void* memory_arena_alloc(MemoryArena* arena, size_t size) {
+    if (!arena || size == 0) return NULL;
+    size = (size + (MEMORY_ALIGNMENT - 1)) & ~(size_t)(MEMORY_ALIGNMENT - 1);
+    
+    ArenaChunk* chunk = arena->head;
+    if (chunk->capacity - chunk->used < size) {
+        chunk = arena_chunk_create(size > arena->chunk_size ? size : arena->chunk_size);
+        if (!chunk) return NULL;
+        chunk->next = arena->head;
+        arena->head = chunk;
+    }
+    
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+void memory_arena_reset(MemoryArena* arena) {
+    if (!arena) return;
+    
+    // Keep the newest chunk for the next round; it is at least chunk_size
+    ArenaChunk* chunk = arena->head->next;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        memory_free(chunk);
+        chunk = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+}
+
+void memory_arena_destroy(MemoryArena* arena) {
+    if (!arena) return;
+    
+    memory_arena_reset(arena);
+    memory_free(arena->head);
+    memory_free(arena);
+}
+
+uint16_t memory_set_owner(uint16_t owner) {
+    uint16_t previous = memory_manager.current_owner;
+    memory_manager.current_owner = owner;
+    return previous;
+}
+
+static void trace_record(TraceOp op, const void* ptr, size_t size, uint8_t type, const void* site) {
+    if (!memory_manager.trace.records || !ptr) return;
+    
+    TraceRecord* record = &memory_manager.trace.records[memory_manager.trace.head];
+    record->site = (uint64_t)(uintptr_t)site;
+    record->address = (uint64_t)(uintptr_t)ptr;
+    record->timestamp = kernel_get_time();
+    record->size = (uint32_t)size;
+    record->owner = memory_manager.current_owner;
+    record->op = (uint8_t)op;
+    record->type = type;
+    record->heap_used = (uint32_t)memory_manager.mm_stats.used_memory;
+    
+    memory_manager.trace.head = (memory_manager.trace.head + 1) % memory_manager.trace.capacity;
+    if (memory_manager.trace.count < memory_manager.trace.capacity) {
+        memory_manager.trace.count++;
+    } else {
+        memory_manager.trace.dropped++;
+    }
+}
+
+bool memory_trace_start(size_t capacity) {
+    if (capacity == 0) return false;
+    memory_trace_stop();
+    
+    // The ring lives outside the managed heap so tracing doesn't perturb it
+    memory_manager.trace.records = malloc(capacity * sizeof(TraceRecord));
+    if (!memory_manager.trace.records) return false;
+    
+    memory_manager.trace.capacity = capacity;
+    memory_manager.trace.head = 0;
+    memory_manager.trace.count = 0;
+    memory_manager.trace.dropped = 0;
+    return true;
+}
+
+void memory_trace_stop(void) {
+    free(memory_manager.trace.records);
+    memory_manager.trace.records = NULL;
+    memory_manager.trace.capacity = 0;
+    memory_manager.trace.count = 0;
+}
+
+void memory_trace_name_owner(uint16_t owner, const char* name) {
+    for (uint16_t i = 0; i < memory_manager.trace.owner_count; i++) {
+        if (memory_manager.trace.owners[i].id == owner) {
+            strncpy(memory_manager.trace.owners[i].name, name, sizeof(memory_manager.trace.owners[i].name) - 1);
+            return;
+        }
+    }
+    if (memory_manager.trace.owner_count >= MAX_TRACE_OWNERS) return;
+    
+    TraceOwnerName* entry = &memory_manager.trace.owners[memory_manager.trace.owner_count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->id = owner;
+    strncpy(entry->name, name, sizeof(entry->name) - 1);
+}
+
+bool memory_trace_dump(const char* path) {
+    if (!memory_manager.trace.records) return false;
+    
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    
+    TraceFileHeader header = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .record_size = sizeof(TraceRecord),
+        .record_count = (uint32_t)memory_manager.trace.count,
+        .dropped = memory_manager.trace.dropped,
+        .heap_base = (uint64_t)(uintptr_t)memory_manager.heap_base,
+        .heap_size = (uint32_t)memory_manager.heap_size,
+        .owner_count = memory_manager.trace.owner_count
+    };
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(memory_manager.trace.owners, sizeof(TraceOwnerName), memory_manager.trace.owner_count, file);
+    
+    // Oldest record first: when the ring has wrapped it starts at head
+    size_t start = memory_manager.trace.count < memory_manager.trace.capacity ? 0 : memory_manager.trace.head;
+    size_t first = memory_manager.trace.capacity - start;
+    if (first > memory_manager.trace.count) first = memory_manager.trace.count;
+    fwrite(&memory_manager.trace.records[start], sizeof(TraceRecord), first, file);
+    fwrite(memory_manager.trace.records, sizeof(TraceRecord), memory_manager.trace.count - first, file);
+    
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+void memory_print_debug_info(void) {
+    printf("Heap: %zu used, %zu free of %zu bytes (peak %zu), %u allocations\n",
+           (size_t)memory_manager.mm_stats.used_memory, (size_t)memory_manager.mm_stats.free_memory,
+           memory_manager.heap_size, memory_manager.stats.peak_usage,
+           (unsigned)memory_manager.mm_stats.allocation_count);
+    printf("Temp: %zu bytes, pressure level %d\n",
+           (size_t)memory_manager.mm_stats.temp_memory, (int)memory_manager.pressure);
+    for (int i = 0; i < MAX_POOLS; i++) {
+        MemoryPool* pool = &memory_manager.pools[i];
+        printf("Pool %zu B: %u/%u blocks\n", pool->block_size, pool->used_blocks, pool->total_blocks);
+    }
+    
+    for (uint8_t i = 0; i < memory_manager.large_span_count; i++) {
+        LargeSpan* span = &memory_manager.large_spans[i];
+        printf("Large span %p: %zu bytes, owner %u\n", (void*)span->base, span->size, span->owner);
+    }
+    
+    // Live pool, heap and span bytes per owner
+    for (uint16_t i = 0; i < memory_manager.trace.owner_count; i++) {
+        TraceOwnerName* owner = &memory_manager.trace.owners[i];
+        size_t live = 0;
+        for (int p = 0; p < MAX_POOLS; p++) {
+            MemoryPool* pool = &memory_manager.pools[p];
+            for (uint32_t word = 0; word < (pool->total_blocks + 63) / 64; word++) {
+                uint64_t used = atomic_load_explicit(&pool->used_map[word], memory_order_relaxed);
+                for (; used; used &= used - 1) {
+                    uint32_t index = word * 64 + (uint32_t)__builtin_ctzll(used);
+                    if (pool->owners[index] == owner->id) live += pool->block_size;
+                }
+            }
+        }
+        for (MemoryBlockHeader* block = memory_manager.heap_start; block; block = block_next(block)) {
+            if (!block->is_free && block->owner == owner->id) live += block->size;
+        }
+        for (uint8_t j = 0; j < memory_manager.large_span_count; j++) {
+            if (memory_manager.large_spans[j].owner == owner->id) live += memory_manager.large_spans[j].size;
+        }
+        printf("Owner %u (%s): %zu bytes\n", owner->id, owner->name, live);
+    }
+}
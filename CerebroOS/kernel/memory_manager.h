@@ -19,9 +19,9 @@ typedef enum {
 
 // Memory Allocation Strategies (for flexibility)
 typedef enum {
-    MEMORY_ALLOC_FIRST_FIT,  // Find the first available block
-    MEMORY_ALLOC_BEST_FIT,    // Find the smallest suitable block
-    MEMORY_ALLOC_POOL        // New pool-based allocation
+    MEMORY_ALLOC_FIRST_FIT,  // TLSF heap; kept for compatibility, same as best fit
+    MEMORY_ALLOC_BEST_FIT,    // TLSF heap (good fit in constant time)
+    MEMORY_ALLOC_POOL        // Block pools first, TLSF heap as fallback
 } MemoryAllocationStrategy;
 
 // Memory block types for different allocation patterns
@@ -59,6 +59,14 @@ typedef struct {
     uint64_t last_access_time;
 } MemoryBlockInfo;
 
+// Memory optimization strategies
+typedef enum {
+    MEMORY_OPT_NONE,
+    MEMORY_OPT_PERFORMANCE,
+    MEMORY_OPT_POWER_SAVING,
+    MEMORY_OPT_BALANCED
+} MemoryOptStrategy;
+
 // Memory manager configuration
 typedef struct {
     MemoryOptStrategy strategy;
@@ -92,14 +100,6 @@ typedef struct {
     uint32_t cache_misses;
 } MemoryStats;
 
-// Memory optimization strategies
-typedef enum {
-    MEMORY_OPT_NONE,
-    MEMORY_OPT_PERFORMANCE,
-    MEMORY_OPT_POWER_SAVING,
-    MEMORY_OPT_BALANCED
-} MemoryOptStrategy;
-
 // Function Declarations
 
 // Initialize memory manager
@@ -119,13 +119,34 @@ void* memory_allocate(size_t size);
 // Allocate memory with specific requirements
 void* memory_allocate_ex(size_t size, BlockType type, uint8_t alignment, bool can_relocate);
 
+// Get the number of bytes usable in an allocated block (at least the size
+// requested), or 0 if the pointer is not a live allocation
+size_t memory_usable_size(void* ptr);
+
 // Free a previously allocated block of memory
 //   - ptr: A pointer to the memory block to free
 void memory_free(void* ptr);
 
+// Relocatable allocations. The defragmenter may move the block behind a
+// handle, so dereference the handle again after anything that can compact.
+typedef void** MemoryHandle;
+MemoryHandle memory_handle_alloc(size_t size, BlockType type);
+void memory_handle_free(MemoryHandle handle);
+
+// Return the calling thread's cached pool blocks to the shared pools.
+// Call before a thread exits so its cached blocks are not stranded.
+void memory_flush_thread_cache(void);
+
 // Defragment the memory pool
 void memory_defragment(void);
 
+// Run one bounded compaction slice (for the kernel idle loop)
+//   - max_bytes: Approximate amount of memory to move before returning
+//   - moved_bytes: If not NULL, increased by the bytes this slice moved
+// Returns:
+//   - true once a full pass over the heap has completed
+bool memory_defragment_step(size_t max_bytes, size_t* moved_bytes);
+
 // Set the power efficiency mode
 //   - mode: The new power efficiency mode
 void memory_set_power_mode(PowerMode mode);
@@ -154,16 +175,71 @@ void memory_trim_unused(void);
 MemoryPressure memory_get_pressure(void);
 void memory_handle_pressure(MemoryPressure pressure);
 
-// Cache management
+// Reclaim callback for subsystems holding rebuildable memory (caches, tries,
+// model arenas, textures). Release what is reasonable for the given level
+// and return the number of bytes freed.
+typedef size_t (*MemoryShrinkCallback)(MemoryPressure pressure, void* context);
+
+// Register a shrinker. Lower priorities run first, so register the cheapest
+// memory to rebuild with the lowest number. Level changes are announced with
+// KERNEL_EVENT_MEMORY_PRESSURE.
+bool memory_register_shrinker(MemoryShrinkCallback callback, void* context, uint8_t priority);
+void memory_unregister_shrinker(MemoryShrinkCallback callback, void* context);
+
+// Cache management. Blocks from memory_cache_alloc() may be compressed
+// when cold but are never evicted.
 void* memory_cache_alloc(size_t size);
 void memory_cache_free(void* ptr);
+
+// Keyed cache entries for rebuildable data (decoded assets and the like).
+// The manager evicts them least recently used first to stay under
+// cache_limit or relieve memory pressure, and drops entries idle for
+// cache_ttl ms. Keep the key rather than the pointer: a pointer from
+// insert or lookup is only valid until the next memory manager call.
+// Key 0 is reserved.
+void* memory_cache_insert(uint32_t key, size_t size);
+void* memory_cache_lookup(uint32_t key);
+
+// Drop every keyed cache entry
 void memory_cache_clear(void);
 
+// Drop keyed entries idle longer than cache_ttl; called on the kernel tick
+void memory_cache_expire(void);
+
+// Make a cache block's data usable again, decompressing it if the manager
+// compressed it. Returns the (possibly moved) data pointer, or NULL if the
+// entry could not be restored and was dropped.
+void* memory_cache_access(void* ptr);
+
+// Arena allocation for short-lived temporaries (per frame, per request).
+// Allocation bumps a pointer; everything is released at once by reset.
+typedef struct MemoryArena MemoryArena;
+MemoryArena* memory_arena_create(size_t chunk_size);
+void* memory_arena_alloc(MemoryArena* arena, size_t size);
+void memory_arena_reset(MemoryArena* arena);
+void memory_arena_destroy(MemoryArena* arena);
+
 // Statistics and monitoring
 MemoryStats memory_get_extended_stats(void);
 BlockMetadata* memory_get_block_metadata(void* ptr);
 void memory_print_debug_info(void);
 
+// Tag subsequent allocations with an owner id (0 is the system). Returns
+// the previous owner so callers can restore it.
+uint16_t memory_set_owner(uint16_t owner);
+
+// Owner tag a live allocation was made under, or 0 if it belongs to the
+// system or the pointer is not a live allocation
+uint16_t memory_get_owner(void* ptr);
+
+// Opt-in allocation tracing. Every allocation and free is recorded with its
+// size, call site, owner and timestamp in a ring of `capacity` entries;
+// memory_trace_dump writes it as a binary heap timeline for offline charts.
+bool memory_trace_start(size_t capacity);
+void memory_trace_stop(void);
+void memory_trace_name_owner(uint16_t owner, const char* name);
+bool memory_trace_dump(const char* path);
+
 // Power management
 void memory_set_power_mode_ex(bool low_power);
 void memory_optimize_for_power(void);
@@ -0,0 +1,45 @@
+#ifndef MEMORY_TRACE_H
+#define MEMORY_TRACE_H
+
+#include <stdint.h>
+
+// File format written by memory_trace_dump() and read back by the allocator
+// benchmark. A dump is a TraceFileHeader, then owner_count TraceOwnerName
+// entries, then record_count TraceRecords, oldest first. All fields are in
+// host byte order; bump TRACE_VERSION on any layout change.
+#define TRACE_MAGIC 0x4C544D43  // "CMTL" in a little-endian dump
+#define TRACE_VERSION 1
+
+typedef enum {
+    TRACE_OP_ALLOC = 1,
+    TRACE_OP_FREE = 2
+} TraceOp;
+
+typedef struct {
+    uint64_t site;        // Return address of the allocator call
+    uint64_t address;
+    uint32_t timestamp;   // kernel_get_time() in milliseconds
+    uint32_t size;
+    uint16_t owner;
+    uint8_t op;           // TraceOp
+    uint8_t type;         // BlockType, or 0xFF for pool blocks
+    uint32_t heap_used;   // Heap bytes in use after the operation
+} TraceRecord;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t record_count;
+    uint32_t dropped;     // Records overwritten before the dump
+    uint64_t heap_base;
+    uint32_t heap_size;
+    uint32_t owner_count;
+} TraceFileHeader;
+
+typedef struct {
+    uint16_t id;
+    char name[30];
+} TraceOwnerName;
+
+#endif // MEMORY_TRACE_H
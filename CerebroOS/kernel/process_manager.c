@@ -1,126 +1,617 @@
+#define _XOPEN_SOURCE 700  // ucontext
+#if defined(__linux__)
+#define _DEFAULT_SOURCE    // MAP_ANONYMOUS, mincore
+#endif
 #include "process_manager.h"
 #include "memory_manager.h"
+#include "../os/hal/clock_hal.h"
 #include <stddef.h>  // for NULL
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ucontext.h>
+#if defined(__linux__)
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
-// Process States (to manage lifecycle)
-typedef enum {
-    PROCESS_STATE_NEW,
-    PROCESS_STATE_READY,
-    PROCESS_STATE_RUNNING,
-    PROCESS_STATE_WAITING, // Add if you need blocking operations
-    PROCESS_STATE_TERMINATED,
-} ProcessState;
+#define MAX_PROCESSES 16
+#define DEFAULT_STACK_SIZE (16 * 1024)
+#define MIN_STACK_SIZE (4 * 1024)
+
+// Stacks are measured and guarded in pages. On the emulator each stack is
+// a lazily committed mapping with an inaccessible guard page below it; on
+// device it comes from the heap, painted so use and overflow can be seen.
+#define STACK_PAGE_SIZE 4096
+#define STACK_GUARD_SIZE STACK_PAGE_SIZE
+#define STACK_PAINT 0xC5C5C5C5u
+#define STACK_CANARY_WORDS 16         // Lowest words that must stay painted
+
+// CPU accounting window. Usage is sampled and CPU limits are replenished
+// once per window.
+#define CPU_WINDOW_US 100000
 
 // Process Control Block (PCB)
 typedef struct {
-    int pid;                      // Process ID
-    void (*entry_point)(void*);   // Function pointer (now takes void* for data)
-    ProcessState state;           // Process state
-    void* stack_pointer;          // Pointer to the process's stack
-    // ... other process information (priority, context, etc.)
+    int pid;                      // Process ID, -1 while the slot is free
+    ProcessEntryPoint entry_point;
+    void* data;
+    ProcessState state;
+    void* stack;                  // Lowest usable address
+    size_t stack_size;
+    ucontext_t context;           // Saved registers while not running
+    uint8_t base_priority;
+    int8_t boost;
+    uint8_t priority;             // Effective level: base plus boost
+    bool queued;                  // On a run queue
+    int prev_ready;               // Run queue links (slot indices, -1 at ends)
+    int next_ready;
+    uint64_t run_time_us;         // Total CPU time, including charged time
+    uint64_t window_run_us;       // CPU time in the current window
+    uint32_t wakeups;             // Times dispatched
+    uint8_t cpu_percent;          // Smoothed share of recent windows
+    uint8_t cpu_limit;            // Percent of each window, 0 for no limit
+    bool throttled;               // Out of CPU credit; kept off the run queues
+    int64_t cpu_credit_us;        // Remaining budget; debt carries over
 } ProcessControlBlock;
 
 // Array to store PCBs
 static ProcessControlBlock processes[MAX_PROCESSES];
 
-// Pointer to the currently running process
+// One FIFO per priority level. Bit n of ready_bitmap is set while level n
+// is non-empty, so the next process is found with a single bit scan.
+static struct {
+    int head;
+    int tail;
+} run_queues[PROCESS_PRIORITY_LEVELS];
+static uint32_t ready_bitmap = 0;
+static int ready_count = 0;
+
+// Pointer to the currently running process, NULL in kernel context
 static ProcessControlBlock* current_process = NULL;
 
+// Kernel context the scheduler switches back to when a process yields
+static ucontext_t scheduler_context;
+
+static struct {
+    uint64_t window_start_us;
+    int throttled_count;
+    bool timer_armed;             // A soft timer will end the window
+} cpu_window;
+
+static uint64_t monotonic_us(void) {
+    uint64_t now = 0;
+    hal_clock_get_uptime_us(&now);
+    return now;
+}
+
+static ProcessControlBlock* find_process(int pid) {
+    if (pid < 0 || pid >= MAX_PROCESSES || processes[pid].pid != pid) return NULL;
+    return &processes[pid];
+}
+
+// Give the CPU back to the scheduler; returns when this process runs again
+static void switch_to_scheduler(void) {
+    swapcontext(&current_process->context, &scheduler_context);
+}
+
+static void run_queue_push(ProcessControlBlock* process) {
+    int slot = (int)(process - processes);
+    int level = process->priority;
+    
+    process->prev_ready = run_queues[level].tail;
+    process->next_ready = -1;
+    if (run_queues[level].tail >= 0) processes[run_queues[level].tail].next_ready = slot;
+    else run_queues[level].head = slot;
+    run_queues[level].tail = slot;
+    
+    process->queued = true;
+    ready_bitmap |= 1u << level;
+    ready_count++;
+}
+
+static void run_queue_remove(ProcessControlBlock* process) {
+    if (!process->queued) return;
+    int level = process->priority;
+    
+    if (process->prev_ready >= 0) processes[process->prev_ready].next_ready = process->next_ready;
+    else run_queues[level].head = process->next_ready;
+    if (process->next_ready >= 0) processes[process->next_ready].prev_ready = process->prev_ready;
+    else run_queues[level].tail = process->prev_ready;
+    
+    process->queued = false;
+    if (run_queues[level].head < 0) ready_bitmap &= ~(1u << level);
+    ready_count--;
+}
+
+// Dequeue the first process of the highest non-empty level
+static ProcessControlBlock* run_queue_pop(void) {
+    if (!ready_bitmap) return NULL;
+    
+    int level = 31 - __builtin_clz(ready_bitmap);
+    ProcessControlBlock* process = &processes[run_queues[level].head];
+    run_queue_remove(process);
+    return process;
+}
+
+static void make_ready(ProcessControlBlock* process) {
+    process->state = PROCESS_STATE_READY;
+    if (!process->queued && !process->throttled) run_queue_push(process);
+}
+
+static void update_priority(ProcessControlBlock* process) {
+    int level = process->base_priority + process->boost;
+    if (level < PROCESS_PRIORITY_IDLE) level = PROCESS_PRIORITY_IDLE;
+    if (level > PROCESS_PRIORITY_REALTIME) level = PROCESS_PRIORITY_REALTIME;
+    if (level == process->priority) return;
+    
+    // Requeue at the tail of the new level
+    bool queued = process->queued;
+    run_queue_remove(process);
+    process->priority = (uint8_t)level;
+    if (queued) run_queue_push(process);
+}
+
+static void set_throttled(ProcessControlBlock* process, bool throttled) {
+    if (process->throttled == throttled) return;
+    process->throttled = throttled;
+    cpu_window.throttled_count += throttled ? 1 : -1;
+    
+    // A throttled READY process waits off the queues for fresh credit
+    if (throttled) run_queue_remove(process);
+    else if (process->state == PROCESS_STATE_READY) run_queue_push(process);
+}
+
+// Close the accounting window: sample each process's usage, then hand out
+// a window's worth of credit to limited processes
+static void end_cpu_window(uint64_t now) {
+    uint64_t length = now - cpu_window.window_start_us;
+    if (length == 0) return;
+    
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        ProcessControlBlock* process = &processes[i];
+        if (process->pid == -1) continue;
+        
+        uint64_t sample = process->window_run_us * 100 / length;
+        if (sample > 100) sample = 100;
+        // Smooth, rounding toward the sample so an idle process reaches 0
+        // and a busy one 100
+        uint32_t blended = process->cpu_percent * 3u + (uint32_t)sample;
+        process->cpu_percent = (uint8_t)(sample > process->cpu_percent ? (blended + 3u) / 4u : blended / 4u);
+        process->window_run_us = 0;
+        
+        if (process->cpu_limit) {
+            int64_t budget = (int64_t)(CPU_WINDOW_US / 100) * process->cpu_limit;
+            process->cpu_credit_us += budget;
+            if (process->cpu_credit_us > budget) process->cpu_credit_us = budget;
+            if (process->cpu_credit_us > 0) set_throttled(process, false);
+        }
+    }
+    cpu_window.window_start_us = now;
+}
+
+static void cpu_window_timer(void* data);
+
+// With every runnable process throttled the kernel loop may sleep, so a
+// timer ends the window rather than the next schedule_processes()
+static void arm_cpu_window_timer(uint64_t now) {
+    if (cpu_window.timer_armed || cpu_window.throttled_count == 0) return;
+    
+    uint64_t elapsed = now - cpu_window.window_start_us;
+    uint64_t remaining = elapsed < CPU_WINDOW_US ? CPU_WINDOW_US - elapsed : 0;
+    TimerConfig config = {
+        .interval_ms = (uint32_t)((remaining + 999) / 1000),
+        .callback = cpu_window_timer,
+    };
+    SoftTimerHandle handle;
+    cpu_window.timer_armed = hal_soft_timer_start(&config, &handle) == CLOCK_HAL_SUCCESS;
+}
+
+static void cpu_window_timer(void* data) {
+    (void)data;
+    cpu_window.timer_armed = false;
+    
+    uint64_t now = monotonic_us();
+    end_cpu_window(now);
+    arm_cpu_window_timer(now);
+}
+
+static void charge_process(ProcessControlBlock* process, uint64_t elapsed_us) {
+    process->run_time_us += elapsed_us;
+    process->window_run_us += elapsed_us;
+    if (process->cpu_limit) {
+        process->cpu_credit_us -= (int64_t)elapsed_us;
+        if (process->cpu_credit_us <= 0) set_throttled(process, true);
+    }
+}
+
+static void* stack_create(size_t size) {
+#if defined(__linux__)
+    // Pages are only committed when first touched
+    uint8_t* mapping = mmap(NULL, size + STACK_GUARD_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) return NULL;
+    if (mprotect(mapping, STACK_GUARD_SIZE, PROT_NONE) != 0) {
+        munmap(mapping, size + STACK_GUARD_SIZE);
+        return NULL;
+    }
+    return mapping + STACK_GUARD_SIZE;
+#else
+    uint32_t* stack = memory_allocate(size);
+    if (!stack) return NULL;
+    for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+        stack[i] = STACK_PAINT;
+    }
+    return stack;
+#endif
+}
+
+static void stack_destroy(void* stack, size_t size) {
+#if defined(__linux__)
+    munmap((uint8_t*)stack - STACK_GUARD_SIZE, size + STACK_GUARD_SIZE);
+#else
+    (void)size;
+    memory_free(stack);
+#endif
+}
+
+// Deepest the stack has reached. Stacks grow down, so this is the span from
+// the top to the lowest page touched (emulator) or word overwritten (device).
+static size_t stack_high_water(const ProcessControlBlock* process) {
+#if defined(__linux__)
+    size_t pages = process->stack_size / STACK_PAGE_SIZE;
+    unsigned char vector[64];
+    for (size_t first = 0; first < pages; first += sizeof(vector)) {
+        size_t count = pages - first < sizeof(vector) ? pages - first : sizeof(vector);
+        uint8_t* start = (uint8_t*)process->stack + first * STACK_PAGE_SIZE;
+        if (mincore(start, count * STACK_PAGE_SIZE, vector) != 0) return 0;
+        for (size_t i = 0; i < count; i++) {
+            if (vector[i] & 1) return process->stack_size - (first + i) * STACK_PAGE_SIZE;
+        }
+    }
+    return 0;
+#else
+    const uint32_t* words = process->stack;
+    size_t count = process->stack_size / sizeof(uint32_t);
+    size_t untouched = 0;
+    while (untouched < count && words[untouched] == STACK_PAINT) untouched++;
+    return (count - untouched) * sizeof(uint32_t);
+#endif
+}
+
+// Emulator overflows hit the guard page and fault; on device the canary
+// words at the bottom are checked after every slice
+static bool stack_overflowed(const ProcessControlBlock* process) {
+#if defined(__linux__)
+    (void)process;
+    return false;
+#else
+    const uint32_t* words = process->stack;
+    for (size_t i = 0; i < STACK_CANARY_WORDS; i++) {
+        if (words[i] != STACK_PAINT) return true;
+    }
+    return false;
+#endif
+}
+
+#if defined(__linux__)
+#define FAULT_STACK_SIZE (16 * 1024)
+
+static struct sigaction previous_fault_action;  // Whoever had SIGSEGV before us
+
+static void write_number(char* buffer, size_t* length, int value) {
+    char digits[12];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count > 0) buffer[(*length)++] = digits[--count];
+}
+
+// Hands a fault that is not ours to the handler installed before us. With
+// none, it is restored and we return, so the fault repeats and kills us
+// as usual.
+static void chain_fault(int signal_number, siginfo_t* info, void* context) {
+    if ((previous_fault_action.sa_flags & SA_SIGINFO) && previous_fault_action.sa_sigaction) {
+        previous_fault_action.sa_sigaction(signal_number, info, context);
+    } else if (previous_fault_action.sa_handler != SIG_DFL &&
+               previous_fault_action.sa_handler != SIG_IGN) {
+        previous_fault_action.sa_handler(signal_number);
+    } else {
+        // An ignored SIGSEGV would only fault again forever
+        signal(signal_number, SIG_DFL);
+    }
+}
+
+// Runs on its own stack, since the faulting one is exhausted. Names the
+// process whose guard page was hit, then lets the fault kill us as usual.
+// Any other fault goes to the previous handler.
+static void stack_fault_handler(int signal_number, siginfo_t* info, void* context) {
+    uint8_t* address = info->si_addr;
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        uint8_t* guard = processes[i].stack ? (uint8_t*)processes[i].stack - STACK_GUARD_SIZE : NULL;
+        if (!guard || address < guard || address >= guard + STACK_GUARD_SIZE) continue;
+
+        char message[64] = "process ";
+        size_t length = strlen(message);
+        write_number(message, &length, processes[i].pid);
+        const char* suffix = ": stack overflow\n";
+        while (*suffix) message[length++] = *suffix++;
+        (void)write(STDERR_FILENO, message, length);
+        signal(signal_number, SIG_DFL);
+        raise(signal_number);
+        return;
+    }
+    chain_fault(signal_number, info, context);
+}
+
+static void install_stack_fault_handler(void) {
+    static bool installed = false;
+    if (installed) return;
+
+    struct sigaction action = { 0 };
+    action.sa_sigaction = stack_fault_handler;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    installed = sigaction(SIGSEGV, &action, &previous_fault_action) == 0;
+}
+
+// The alternate signal stack is per thread, so each thread that runs
+// processes gets its own the first time it schedules. It is kept for the
+// life of the thread.
+static void install_fault_stack(void) {
+    static _Thread_local bool installed = false;
+    if (installed) return;
+    installed = true;
+
+    stack_t current;
+    if (sigaltstack(NULL, &current) == 0 && !(current.ss_flags & SS_DISABLE)) return;
+
+    void* memory = mmap(NULL, FAULT_STACK_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return;
+    stack_t alternate = { .ss_sp = memory, .ss_size = FAULT_STACK_SIZE };
+    if (sigaltstack(&alternate, NULL) != 0) munmap(memory, FAULT_STACK_SIZE);
+}
+#endif
+
+static void release_process(ProcessControlBlock* process) {
+    set_throttled(process, false);
+    run_queue_remove(process);
+    stack_destroy(process->stack, process->stack_size);
+    process->stack = NULL;
+    process->pid = -1;
+}
+
+// First code a process runs. Returning from here resumes the scheduler
+// through uc_link.
+static void process_trampoline(int slot) {
+    ProcessControlBlock* process = &processes[slot];
+    process->entry_point(process->data);
+    process->state = PROCESS_STATE_TERMINATED;
+}
+
 // Initialize the process manager
 void process_init() {
     for (int i = 0; i < MAX_PROCESSES; i++) {
         processes[i].pid = -1;
-        processes[i].state = PROCESS_STATE_NEW; // Mark all processes as new
-        processes[i].stack_pointer = NULL;
+        processes[i].state = PROCESS_STATE_TERMINATED;
+        processes[i].stack = NULL;
+        processes[i].queued = false;
+        processes[i].throttled = false;
+    }
+    for (int level = 0; level < PROCESS_PRIORITY_LEVELS; level++) {
+        run_queues[level].head = -1;
+        run_queues[level].tail = -1;
     }
+    ready_bitmap = 0;
+    ready_count = 0;
+    current_process = NULL;
+    cpu_window.window_start_us = monotonic_us();
+    cpu_window.throttled_count = 0;
+#if defined(__linux__)
+    install_stack_fault_handler();
+#endif
 }
 
 // Create a new process
-int create_process(void (*entry_point)(void*), void* data) {
+int create_process(const ProcessCreateInfo* createInfo) {
+    if (!createInfo || !createInfo->entry_point) return -1;
+
     for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (processes[i].state == PROCESS_STATE_NEW) {
-            processes[i].pid = i;
-            processes[i].entry_point = entry_point;
-            processes[i].state = PROCESS_STATE_READY;
-
-            // Allocate stack for the process
-            processes[i].stack_pointer = memory_allocate(STACK_SIZE); 
-            if (!processes[i].stack_pointer) {
-                return -1; // Stack allocation failed
-            }
-            
-            // Initialize stack (e.g., set up arguments, return address, etc.)
-            initialize_stack(processes[i].stack_pointer, entry_point, data);
-
-            return i;
+        ProcessControlBlock* process = &processes[i];
+        if (process->pid != -1) continue;
+
+        size_t stack_size = createInfo->stack_size ? createInfo->stack_size : DEFAULT_STACK_SIZE;
+        if (stack_size < MIN_STACK_SIZE) stack_size = MIN_STACK_SIZE;
+        stack_size = (stack_size + STACK_PAGE_SIZE - 1) & ~(size_t)(STACK_PAGE_SIZE - 1);
+
+        process->stack = stack_create(stack_size);
+        if (!process->stack) {
+            return -1; // Stack allocation failed
+        }
+
+        // Build a context that starts in the trampoline on the new stack
+        if (getcontext(&process->context) != 0) {
+            stack_destroy(process->stack, stack_size);
+            process->stack = NULL;
+            return -1;
         }
+        process->context.uc_stack.ss_sp = process->stack;
+        process->context.uc_stack.ss_size = stack_size;
+        process->context.uc_link = &scheduler_context;
+        makecontext(&process->context, (void (*)(void))process_trampoline, 1, i);
+
+        process->pid = i;
+        process->entry_point = createInfo->entry_point;
+        process->data = createInfo->data;
+        process->stack_size = stack_size;
+        process->base_priority = createInfo->priority != PROCESS_PRIORITY_DEFAULT ?
+                                 createInfo->priority : PROCESS_PRIORITY_NORMAL;
+        process->boost = 0;
+        process->priority = process->base_priority;
+        process->queued = false;
+        process->throttled = false;
+        process->run_time_us = 0;
+        process->window_run_us = 0;
+        process->wakeups = 0;
+        process->cpu_percent = 0;
+        process->cpu_limit = 0;
+        process->cpu_credit_us = 0;
+        make_ready(process);
+        return i;
     }
     return -1; // No available slots for new processes
 }
 
-// Round-Robin Scheduler (very basic)
+// Dispatch READY processes, highest priority first. The pass is bounded by
+// the number ready on entry so a process that keeps yielding cannot hold
+// off the rest of the kernel loop. Returns at once when nothing is ready.
 void schedule_processes() {
-    if (current_process && current_process->state == PROCESS_STATE_RUNNING) {
-        current_process->state = PROCESS_STATE_READY;
+    // Only the kernel context schedules
+    if (current_process) return;
+#if defined(__linux__)
+    install_fault_stack();
+#endif
+
+    uint64_t now = monotonic_us();
+    if (now - cpu_window.window_start_us >= CPU_WINDOW_US) end_cpu_window(now);
+
+    for (int budget = ready_count; budget > 0; budget--) {
+        ProcessControlBlock* process = run_queue_pop();
+        if (!process) break;
+
+        process->state = PROCESS_STATE_RUNNING;
+        process->wakeups++;
+        current_process = process;
+        swapcontext(&scheduler_context, &process->context);
+        current_process = NULL;
+
+        // Every switch back is timestamped and the slice charged
+        uint64_t switched = monotonic_us();
+        charge_process(process, switched - now);
+        now = switched;
+
+        // Whatever lies below a smashed stack is suspect; stop the process
+        // before it does more damage
+        if (stack_overflowed(process)) {
+            process->state = PROCESS_STATE_TERMINATED;
+        }
+
+        // A process cannot free the stack it is running on; reap it here
+        if (process->state == PROCESS_STATE_TERMINATED) {
+            release_process(process);
+        } else if (process->state == PROCESS_STATE_READY && !process->throttled) {
+            run_queue_push(process);
+        }
     }
+    arm_cpu_window_timer(now);
+}
 
-    do {
-        current_process = &processes[(current_process ? current_process->pid + 1 : 0) % MAX_PROCESSES];
-    } while (current_process->state != PROCESS_STATE_READY);
+void process_yield() {
+    if (!current_process) return;
 
-    current_process->state = PROCESS_STATE_RUNNING;
-    switch_to_process(current_process->stack_pointer); 
+    // The scheduler puts it back on its queue
+    current_process->state = PROCESS_STATE_READY;
+    switch_to_scheduler();
 }
 
-// Current running process
-static ProcessControlBlock* current_process = NULL;
+bool process_has_ready() {
+    return ready_count > 0;
+}
 
-// Initialize the process manager
-void process_init() {
-    // ... (same as before)
+// Get the current process's PID
+int get_current_process_id() {
+    return current_process ? current_process->pid : -1;
+}
 
-    // Initialize the timer for context switching (if using a timer-based approach)
-    timer_init();
+// Terminate a process
+void terminate_process(int pid) {
+    ProcessControlBlock* process = find_process(pid);
+    if (!process) return;
+
+    process->state = PROCESS_STATE_TERMINATED;
+    if (process == current_process) {
+        // Never returns; the scheduler frees the stack
+        switch_to_scheduler();
+    }
+    release_process(process);
 }
 
-// Create a new process (as before)
-int create_process(void (*entry_point)(void*), void* data) {
-    // ... (same as before)
+// Suspend a process (pause execution)
+void suspend_process(int pid) {
+    ProcessControlBlock* process = find_process(pid);
+    if (!process || process->state == PROCESS_STATE_TERMINATED) return;
+
+    run_queue_remove(process);
+    process->state = PROCESS_STATE_WAITING;
+    if (process == current_process) {
+        switch_to_scheduler();
+    }
 }
 
-// Switch to a specific process (context switching)
-void switch_to_process(void* stack_pointer) {
-    // Save the current process's context (if there is one)
-    if (current_process) {
-        save_context(current_process->stack_pointer); 
+// Resume a suspended process
+void resume_process(int pid) {
+    ProcessControlBlock* process = find_process(pid);
+    if (process && process->state == PROCESS_STATE_WAITING) {
+        make_ready(process);
     }
+}
+
+// Get the state of a process
+ProcessState get_process_state(int pid) {
+    ProcessControlBlock* process = find_process(pid);
+    return process ? process->state : PROCESS_STATE_TERMINATED;
+}
 
-    // Update the current_process pointer
-    current_process = (ProcessControlBlock*)((uint8_t*)stack_pointer - sizeof(ProcessControlBlock));
+void process_set_priority(int pid, ProcessPriority priority) {
+    ProcessControlBlock* process = find_process(pid);
+    if (!process || priority == PROCESS_PRIORITY_DEFAULT || priority >= PROCESS_PRIORITY_LEVELS) return;
 
-    // Restore the new process's context
-    restore_context(stack_pointer);
+    process->base_priority = (uint8_t)priority;
+    update_priority(process);
 }
 
-// Round-Robin Scheduler (with timer interrupt)
-void timer_interrupt_handler() { 
-    schedule_processes(); // Trigger scheduling when timer interrupt occurs
+void process_set_cpu_limit(int pid, uint32_t percent) {
+    ProcessControlBlock* process = find_process(pid);
+    if (!process) return;
+
+    process->cpu_limit = (uint8_t)(percent >= 100 ? 0 : percent);
+    process->cpu_credit_us = (int64_t)(CPU_WINDOW_US / 100) * process->cpu_limit;
+    if (!process->cpu_limit) set_throttled(process, false);
 }
 
-void schedule_processes() {
-    // ... (Round-robin scheduling logic from previous response)
+void process_charge_time(int pid, uint64_t elapsed_us) {
+    ProcessControlBlock* process = find_process(pid);
+    if (!process) return;
+
+    charge_process(process, elapsed_us);
+    arm_cpu_window_timer(monotonic_us());
 }
 
-// Terminate the current process
-void terminate_process() {
-    if (current_process) {
-        current_process->state = PROCESS_STATE_TERMINATED;
-        memory_free(current_process->stack_pointer); // Free the process's stack
-        current_process = NULL; // No process running now
+bool process_get_stats(int pid, ProcessStats* stats) {
+    ProcessControlBlock* process = find_process(pid);
+    if (!process || !stats) return false;
 
-        // Find the next ready process to run
-        schedule_processes();
-    }
+    stats->pid = process->pid;
+    stats->state = process->state;
+    stats->priority = (ProcessPriority)process->priority;
+    stats->run_time_us = process->run_time_us;
+    stats->wakeups = process->wakeups;
+    stats->cpu_percent = process->cpu_percent;
+    stats->cpu_limit = process->cpu_limit;
+    stats->throttled = process->throttled;
+    stats->stack_size = process->stack_size;
+    stats->stack_high_water = stack_high_water(process);
+    return true;
 }
 
-// ... (other process management functions)
+void process_set_boost(int pid, int boost) {
+    ProcessControlBlock* process = find_process(pid);
+    if (!process) return;
+
+    process->boost = (int8_t)boost;
+    update_priority(process);
+}
@@ -2,6 +2,8 @@
 #define PROCESS_MANAGER_H
 
 #include <stddef.h>  // For size_t (data type for sizes)
+#include <stdint.h>
+#include <stdbool.h>
 
 // Process States
 typedef enum {
@@ -12,6 +14,21 @@ typedef enum {
     PROCESS_STATE_TERMINATED, // Finished execution
 } ProcessState;
 
+// Scheduling priorities. Higher values run first; within a level processes
+// run in FIFO order.
+typedef enum {
+    PROCESS_PRIORITY_DEFAULT = 0,     // Same as PROCESS_PRIORITY_NORMAL
+    PROCESS_PRIORITY_IDLE = 1,
+    PROCESS_PRIORITY_BACKGROUND = 2,
+    PROCESS_PRIORITY_LOW = 3,
+    PROCESS_PRIORITY_NORMAL = 4,
+    PROCESS_PRIORITY_HIGH = 5,
+    PROCESS_PRIORITY_INTERACTIVE = 6, // UI
+    PROCESS_PRIORITY_REALTIME = 7     // Call audio and other hard latency paths
+} ProcessPriority;
+
+#define PROCESS_PRIORITY_LEVELS 8
+
 // Function Pointer Type for Entry Points (now takes optional data)
 typedef void (*ProcessEntryPoint)(void* data);
 
@@ -19,7 +36,9 @@ typedef void (*ProcessEntryPoint)(void* data);
 typedef struct {
     ProcessEntryPoint entry_point; // Function to start the process
     void* data;                   // Optional data to pass to the entry point
-    size_t stack_size;            // Stack size needed for the process (optional, default could be used)
+    size_t stack_size;            // Stack size needed for the process (optional, default could be used).
+                                  // Rounded up to whole pages; size it from stack_high_water.
+    ProcessPriority priority;     // Base priority (optional)
 } ProcessCreateInfo;
 
 // Function Declarations
@@ -33,9 +52,18 @@ void process_init();
 //   - Process ID (PID) if successful, or -1 on failure
 int create_process(const ProcessCreateInfo* createInfo);
 
-// Schedule processes (e.g., round-robin scheduling)
+// Run READY processes, highest priority first, each until it yields,
+// blocks or exits. One call dispatches at most as many processes as were
+// ready when it started. Processes are cooperative green threads; call this
+// from the kernel loop, never from inside a process.
 void schedule_processes();
 
+// Give up the CPU from inside a process; it stays READY
+void process_yield();
+
+// True if any process is waiting to run
+bool process_has_ready();
+
 // Optional Functions (add as needed)
 
 // Get the current process's PID
@@ -44,7 +72,8 @@ int get_current_process_id();
 // Terminate a process
 void terminate_process(int pid);
 
-// Suspend a process (pause execution)
+// Suspend a process (pause execution). A process may suspend itself to
+// block until another party calls resume_process().
 void suspend_process(int pid);
 
 // Resume a suspended process
@@ -53,4 +82,36 @@ void resume_process(int pid);
 // Get the state of a process
 ProcessState get_process_state(int pid);
 
+// Change a process's base priority
+void process_set_priority(int pid, ProcessPriority priority);
+
+// Raise (positive) or lower (negative) a process's priority relative to its
+// base, e.g. while its app is in the foreground. Replaces any earlier boost.
+void process_set_boost(int pid, int boost);
+
+// CPU accounting, measured at every context switch
+typedef struct {
+    int pid;
+    ProcessState state;
+    ProcessPriority priority;     // Effective priority, boost included
+    uint64_t run_time_us;         // Total CPU time
+    uint32_t wakeups;             // Times dispatched
+    uint8_t cpu_percent;          // Recent share of the CPU
+    uint8_t cpu_limit;            // 0 when unlimited
+    bool throttled;               // Held back until its budget refills
+    size_t stack_size;            // Reserved stack
+    size_t stack_high_water;      // Deepest use so far (page granular on the emulator)
+} ProcessStats;
+
+bool process_get_stats(int pid, ProcessStats* stats);
+
+// Cap a process at a share of the CPU, averaged over short windows. Once it
+// overspends it is kept off the run queues until its budget is repaid.
+// 0 or 100 removes the cap.
+void process_set_cpu_limit(int pid, uint32_t percent);
+
+// Bill CPU time spent on a process's behalf outside it (e.g. its app's
+// event handlers) to its usage and budget
+void process_charge_time(int pid, uint64_t elapsed_us);
+
 #endif // PROCESS_MANAGER_H
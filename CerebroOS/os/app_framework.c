@@ -1,58 +1,529 @@
 #include "app_framework.h"
 #include "../kernel/memory_manager.h"
+#include "../kernel/process_manager.h"
+#include "hal/clock_hal.h"
 #include <string.h>
 #include <stdlib.h>
 
 #define MAX_APPS 32
-#define MAX_EVENTS 64
-#define MAX_HANDLERS_PER_EVENT 8
 
+// Interned names. Bucket arrays are kept at most half full so probe runs
+// stay short. App names share one small table; topics grow as needed.
+#define MAX_APP_NAMES 256
+#define MAX_TOPICS UINT16_MAX
+#define SYMBOL_NAME_LENGTH 63
+#define SYMBOL_INITIAL_CAPACITY 32
+
+// Subscription ids keep the slot index in their low 16 bits
+#define MAX_SUBSCRIPTIONS 0xFFFEu
+#define SUBSCRIBERS_INITIAL_CAPACITY 4
+
+// Deferred deliveries queued across all apps, and how many one app runs
+// per turn before the next app's queue is served
+#define EVENT_QUEUE_CAPACITY 256
+#define EVENT_DISPATCH_BATCH 8
+
+// Priority adjustment for an app's process, relative to its base priority
+#define APP_FOREGROUND_BOOST 1
+#define APP_BACKGROUND_BOOST (-2)
+
+// An app's handler for a topic or topic pattern
+typedef struct {
+    EventHandler handler;
+    AppId owner;                  // 0 while the slot is free
+    uint16_t generation;          // Bumped on release so stale ids are rejected
+    EventId topic;
+    uint32_t next_free;           // Free list link (index + 1)
+} Subscription;
+
+// Subscriber lists are resolved ahead of time: a pattern subscription is
+// added to every matching topic, now or when the topic is first seen, so
+// publishing walks only the topic's own list.
+typedef struct {
+    SubscriptionId* subscribers;  // May hold released ids, skipped on delivery
+    uint32_t subscriber_count;
+    uint32_t subscriber_capacity;
+    bool pattern;                 // Has wildcards; can be subscribed, not published
+    EventLatencyStats stats;      // Percentiles filled in on request
+} Topic;
+
+// One pending delivery of an event to one subscription
+typedef struct {
+    SubscriptionId subscription;
+    EventId event_id;
+    bool coalesce;
+    uint32_t key;
+    void* data;
+    uint64_t posted_us;
+    uint16_t next;                // Entry index + 1, 0 at the end
+} QueuedEvent;
+
+// FIFO of entries (index + 1, 0 when empty)
 typedef struct {
-    char name[32];
-    EventHandler handlers[MAX_HANDLERS_PER_EVENT];
-    uint8_t handler_count;
-} Event;
+    uint16_t head;
+    uint16_t tail;
+} EventLane;
+
+// Entries come from one shared pool: a bump index, then a free list, so
+// zeroed state is a valid empty bus. Each subscribing app has one FIFO per
+// priority lane, indexed by AppId so they survive the app table shifting.
+static struct {
+    QueuedEvent entries[EVENT_QUEUE_CAPACITY];
+    uint16_t used;
+    uint16_t free_head;
+    uint32_t pending;
+    EventLane lanes[MAX_APP_NAMES + 1][EVENT_PRIORITY_LANES];
+} event_bus;
+
+// String-to-id table with open addressing (linear probing), grown by
+// doubling. Symbols are never removed, so ids stay valid and probe chains
+// never break.
+typedef struct {
+    char (*names)[SYMBOL_NAME_LENGTH + 1];  // Symbol n at names[n - 1]
+    uint16_t* buckets;                      // Symbol id, 0 when empty
+    uint32_t bucket_count;                  // Power of two, at least twice capacity
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t limit;
+} SymbolTable;
+
+static SymbolTable app_names = { .limit = MAX_APP_NAMES };
+static SymbolTable topic_names = { .limit = MAX_TOPICS };
+
+static struct {
+    Topic* items;                 // Indexed by EventId
+    uint32_t capacity;
+} topics;
+
+static struct {
+    Subscription* items;
+    uint32_t used;
+    uint32_t capacity;
+    uint32_t free_head;
+    uint32_t pattern_count;       // Live pattern subscriptions
+} subscriptions;
 
 static struct {
     AppInstance apps[MAX_APPS];
     uint8_t app_count;
-    Event events[MAX_EVENTS];
-    uint8_t event_count;
+    uint8_t app_slots[MAX_APP_NAMES + 1];  // AppId to apps index + 1, 0 if none
+    uint16_t next_owner_id;
+    uint64_t last_snapshot_us;
+    uint32_t dispatch_depth;      // Handlers running; subscriber lists only grow
 } framework;
 
+// Grow a heap array by doubling to hold at least `needed` items, up to
+// `limit`. Contents are kept and new space is zeroed.
+static bool grow_array(void** items, uint32_t* capacity, uint32_t needed, size_t item_size,
+                       uint32_t initial, uint32_t limit) {
+    if (needed <= *capacity) return true;
+    if (needed > limit) return false;
+    
+    uint32_t grown = *capacity ? *capacity : initial;
+    while (grown < needed) grown = grown > limit / 2 ? limit : grown * 2;
+    
+    void* resized = memory_allocate((size_t)grown * item_size);
+    if (!resized) return false;
+    memset(resized, 0, (size_t)grown * item_size);
+    if (*items) {
+        memcpy(resized, *items, (size_t)*capacity * item_size);
+        memory_free(*items);
+    }
+    *items = resized;
+    *capacity = grown;
+    return true;
+}
+
+// FNV-1a over the part of the name that is stored
+static uint32_t hash_name(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < SYMBOL_NAME_LENGTH && name[i]; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Bucket holding the name, or the empty bucket where it would go
+static uint32_t symbol_probe(const SymbolTable* table, const char* name) {
+    uint32_t mask = table->bucket_count - 1;
+    uint32_t bucket = hash_name(name) & mask;
+    while (table->buckets[bucket] &&
+           strncmp(table->names[table->buckets[bucket] - 1], name, SYMBOL_NAME_LENGTH) != 0) {
+        bucket = (bucket + 1) & mask;
+    }
+    return bucket;
+}
+
+static bool symbols_grow(SymbolTable* table) {
+    uint32_t capacity = table->capacity;
+    if (!grow_array((void**)&table->names, &capacity, table->count + 1, sizeof(*table->names),
+                    SYMBOL_INITIAL_CAPACITY, table->limit)) {
+        return false;
+    }
+    
+    uint32_t bucket_count = 1;
+    while (bucket_count < capacity * 2) bucket_count <<= 1;
+    uint16_t* buckets = memory_allocate(bucket_count * sizeof(uint16_t));
+    if (!buckets) return false;
+    memset(buckets, 0, bucket_count * sizeof(uint16_t));
+    
+    // Rehash every name into the larger bucket array
+    memory_free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_count = bucket_count;
+    table->capacity = capacity;
+    for (uint32_t id = 1; id <= table->count; id++) {
+        table->buckets[symbol_probe(table, table->names[id - 1])] = (uint16_t)id;
+    }
+    return true;
+}
+
+// Symbol id for a name, adding it when create is set. Returns 0 if the name
+// is unknown (or the table cannot grow).
+static uint16_t intern(SymbolTable* table, const char* name, bool create) {
+    if (!name) return 0;
+    
+    if (table->bucket_count) {
+        uint16_t id = table->buckets[symbol_probe(table, name)];
+        if (id) return id;
+    }
+    if (!create) return 0;
+    if (table->count == table->capacity && !symbols_grow(table)) return 0;
+    
+    uint16_t id = (uint16_t)++table->count;
+    strncpy(table->names[id - 1], name, SYMBOL_NAME_LENGTH);
+    table->buckets[symbol_probe(table, name)] = id;
+    return id;
+}
+
+static AppInstance* app_from_id(AppId id) {
+    if (id == 0 || id > MAX_APP_NAMES || !framework.app_slots[id]) return NULL;
+    return &framework.apps[framework.app_slots[id] - 1];
+}
+
+static Topic* topic_from_id(EventId id) {
+    if (id == 0 || id > topic_names.count || id >= topics.capacity) return NULL;
+    return &topics.items[id];
+}
+
+static Subscription* subscription_from_id(SubscriptionId id) {
+    uint32_t index = (id & 0xFFFFu) - 1;
+    if (index >= subscriptions.used) return NULL;
+    
+    Subscription* subscription = &subscriptions.items[index];
+    if (!subscription->owner || subscription->generation != (uint16_t)(id >> 16)) return NULL;
+    return subscription;
+}
+
+static uint64_t monotonic_us(void) {
+    uint64_t now = 0;
+    hal_clock_get_uptime_us(&now);
+    return now;
+}
+
 static AppInstance* find_app(const char* app_name) {
-    for (int i = 0; i < framework.app_count; i++) {
-        if (strcmp(framework.apps[i].config.name, app_name) == 0) {
-            return &framework.apps[i];
+    return app_from_id(intern(&app_names, app_name, false));
+}
+
+// Bill time spent running app code outside its process. It also counts
+// against the process's CPU limit.
+static void charge_app(AppInstance* app, uint64_t elapsed_us) {
+    app->cpu_time_us += elapsed_us;
+    app->wakeups++;
+    if (app->process_id >= 0) {
+        process_charge_time(app->process_id, elapsed_us);
+        app->process_time_seen += elapsed_us;  // Already counted above
+    }
+}
+
+// Bring in the attached process's run time and dispatches since last time
+static void fold_process_usage(AppInstance* app) {
+    ProcessStats stats;
+    if (app->process_id < 0 || !process_get_stats(app->process_id, &stats)) return;
+    
+    if (stats.run_time_us > app->process_time_seen) {
+        app->cpu_time_us += stats.run_time_us - app->process_time_seen;
+    }
+    app->wakeups += stats.wakeups - app->process_wakeups_seen;
+    app->process_time_seen = stats.run_time_us;
+    app->process_wakeups_seen = stats.wakeups;
+}
+
+// Run an app callback with the app as owner of any memory it allocates
+static void run_app_callback(AppInstance* app, void (*callback)(void)) {
+    if (!callback) return;
+    
+    uint16_t previous = memory_set_owner(app->owner_id);
+    uint64_t start = monotonic_us();
+    callback();
+    charge_app(app, monotonic_us() - start);
+    memory_set_owner(previous);
+}
+
+// Move the app's process between the foreground and background tiers
+static void update_process_boost(AppInstance* app) {
+    if (app->process_id < 0) return;
+    
+    switch (app->state) {
+        case APP_STATE_RUNNING:
+            process_set_boost(app->process_id, APP_FOREGROUND_BOOST);
+            break;
+        case APP_STATE_PAUSED:
+        case APP_STATE_STOPPED:
+            process_set_boost(app->process_id, APP_BACKGROUND_BOOST);
+            break;
+        default:
+            process_set_boost(app->process_id, 0);
+            break;
+    }
+}
+
+// Topic levels are separated by '/'. In a pattern a '*' level matches
+// exactly one level and a final '#' level matches all remaining levels,
+// including none: "net/status/*" matches "net/status/wifi", and "net/#"
+// matches "net" and "net/status/wifi".
+static bool topic_matches(const char* pattern, const char* topic) {
+    for (;;) {
+        if (pattern[0] == '#' && pattern[1] == '\0') return true;
+        if (pattern[0] == '*' && (pattern[1] == '/' || pattern[1] == '\0')) {
+            while (*topic && *topic != '/') topic++;
+            pattern++;
+        } else {
+            while (*pattern && *pattern != '/') {
+                if (*pattern++ != *topic++) return false;
+            }
+        }
+        
+        // Both levels must end together
+        if (*topic == '\0' && strcmp(pattern, "/#") == 0) return true;
+        if (*pattern != *topic) return false;
+        if (*pattern == '\0') return true;
+        pattern++;
+        topic++;
+    }
+}
+
+static bool is_pattern(const char* topic) {
+    for (const char* level = topic; level; level = strchr(level, '/')) {
+        if (*level == '/') level++;
+        if (level[0] == '*' && (level[1] == '/' || level[1] == '\0')) return true;
+        if (level[0] == '#' && level[1] == '\0') return true;
+    }
+    return false;
+}
+
+static bool topic_is_live(const Topic* topic, uint32_t index) {
+    return subscription_from_id(topic->subscribers[index]) != NULL;
+}
+
+// Squeeze released subscriptions out of a list. Never while handlers run,
+// so a publish walking the list by index sees no entries move.
+static void topic_compact(Topic* topic) {
+    if (framework.dispatch_depth) return;
+    
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < topic->subscriber_count; i++) {
+        if (topic_is_live(topic, i)) topic->subscribers[kept++] = topic->subscribers[i];
+    }
+    topic->subscriber_count = kept;
+}
+
+static bool topic_add_subscriber(EventId topic_id, SubscriptionId subscription) {
+    Topic* topic = topic_from_id(topic_id);
+    if (!topic) return false;
+    
+    if (topic->subscriber_count == topic->subscriber_capacity) topic_compact(topic);
+    if (!grow_array((void**)&topic->subscribers, &topic->subscriber_capacity, topic->subscriber_count + 1,
+                    sizeof(SubscriptionId), SUBSCRIBERS_INITIAL_CAPACITY, UINT32_MAX / sizeof(SubscriptionId))) {
+        return false;
+    }
+    topic->subscribers[topic->subscriber_count++] = subscription;
+    return true;
+}
+
+// Id for a topic or pattern. A new concrete topic picks up the pattern
+// subscriptions that match it.
+static EventId topic_intern(const char* name, bool create) {
+    EventId id = intern(&topic_names, name, false);
+    if (id || !create) return id;
+    
+    // Make room for the topic first, so a name is never bound without one
+    if (!grow_array((void**)&topics.items, &topics.capacity, topic_names.count + 2, sizeof(Topic),
+                    SYMBOL_INITIAL_CAPACITY, MAX_TOPICS + 1u)) {
+        return 0;
+    }
+    id = intern(&topic_names, name, true);
+    if (!id) return 0;
+    Topic* topic = &topics.items[id];
+    topic->pattern = is_pattern(topic_names.names[id - 1]);
+    
+    for (uint32_t i = 0; !topic->pattern && subscriptions.pattern_count && i < subscriptions.used; i++) {
+        Subscription* subscription = &subscriptions.items[i];
+        if (subscription->owner && topics.items[subscription->topic].pattern &&
+            topic_matches(topic_names.names[subscription->topic - 1], topic_names.names[id - 1])) {
+            topic_add_subscriber(id, ((SubscriptionId)subscription->generation << 16) | (i + 1));
         }
     }
-    return NULL;
+    return id;
 }
 
-static Event* find_event(const char* event_name) {
-    for (int i = 0; i < framework.event_count; i++) {
-        if (strcmp(framework.events[i].name, event_name) == 0) {
-            return &framework.events[i];
+static SubscriptionId subscription_alloc(AppId owner, EventId topic, EventHandler handler) {
+    uint32_t index;
+    if (subscriptions.free_head) {
+        index = subscriptions.free_head - 1;
+        subscriptions.free_head = subscriptions.items[index].next_free;
+    } else {
+        if (!grow_array((void**)&subscriptions.items, &subscriptions.capacity, subscriptions.used + 1,
+                        sizeof(Subscription), SYMBOL_INITIAL_CAPACITY, MAX_SUBSCRIPTIONS)) {
+            return 0;
         }
+        index = subscriptions.used++;
     }
-    return NULL;
+    
+    Subscription* subscription = &subscriptions.items[index];
+    subscription->handler = handler;
+    subscription->owner = owner;
+    subscription->topic = topic;
+    subscription->next_free = 0;
+    if (topics.items[topic].pattern) subscriptions.pattern_count++;
+    return ((SubscriptionId)subscription->generation << 16) | (index + 1);
+}
+
+// Free a subscription and, unless handlers are running, drop it from the
+// subscriber lists now. Otherwise it is skipped until a later append
+// squeezes it out.
+static void subscription_release(SubscriptionId id) {
+    uint32_t index = (id & 0xFFFFu) - 1;
+    Subscription* subscription = &subscriptions.items[index];
+    Topic* topic = &topics.items[subscription->topic];
+    const char* pattern = topic_names.names[subscription->topic - 1];
+    
+    if (topic->pattern) subscriptions.pattern_count--;
+    subscription->owner = 0;
+    subscription->handler = NULL;
+    subscription->generation++;
+    subscription->next_free = subscriptions.free_head;
+    subscriptions.free_head = index + 1;
+    
+    if (framework.dispatch_depth) return;
+    if (!topic->pattern) {
+        topic_compact(topic);
+        return;
+    }
+    for (uint32_t i = 1; i <= topic_names.count && i < topics.capacity; i++) {
+        if (!topics.items[i].pattern && topic_matches(pattern, topic_names.names[i - 1])) {
+            topic_compact(&topics.items[i]);
+        }
+    }
+}
+
+// Release an app's subscriptions to one topic or pattern, or to all when
+// topic_id is 0. Returns how many there were.
+static uint32_t release_app_subscriptions(AppId app_id, EventId topic_id) {
+    uint32_t released = 0;
+    for (uint32_t i = 0; i < subscriptions.used; i++) {
+        Subscription* subscription = &subscriptions.items[i];
+        if (subscription->owner != app_id || (topic_id && subscription->topic != topic_id)) continue;
+        subscription_release(((SubscriptionId)subscription->generation << 16) | (i + 1));
+        released++;
+    }
+    return released;
+}
+
+static QueuedEvent* entry_alloc(void) {
+    uint16_t index;
+    if (event_bus.free_head) {
+        index = event_bus.free_head - 1;
+        event_bus.free_head = event_bus.entries[index].next;
+    } else if (event_bus.used < EVENT_QUEUE_CAPACITY) {
+        index = event_bus.used++;
+    } else {
+        return NULL;
+    }
+    event_bus.pending++;
+    return &event_bus.entries[index];
+}
+
+static void entry_free(QueuedEvent* entry) {
+    entry->next = event_bus.free_head;
+    event_bus.free_head = (uint16_t)(entry - event_bus.entries) + 1;
+    event_bus.pending--;
+}
+
+static void lane_push(EventLane* lane, QueuedEvent* entry) {
+    uint16_t link = (uint16_t)(entry - event_bus.entries) + 1;
+    entry->next = 0;
+    if (lane->tail) event_bus.entries[lane->tail - 1].next = link;
+    else lane->head = link;
+    lane->tail = link;
+}
+
+static QueuedEvent* lane_pop(EventLane* lane) {
+    if (!lane->head) return NULL;
+    QueuedEvent* entry = &event_bus.entries[lane->head - 1];
+    lane->head = entry->next;
+    if (!lane->head) lane->tail = 0;
+    return entry;
+}
+
+// Drop everything still queued for an app
+static void drop_app_events(AppId app_id) {
+    for (int priority = 0; priority < EVENT_PRIORITY_LANES; priority++) {
+        QueuedEvent* entry;
+        while ((entry = lane_pop(&event_bus.lanes[app_id][priority]))) {
+            entry_free(entry);
+        }
+    }
+}
+
+static void record_latency(EventLatencyStats* stats, uint64_t latency_us) {
+    uint32_t latency = latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us;
+    int bucket = latency < 2 ? 0 : 31 - __builtin_clz(latency);
+    if (bucket >= EVENT_LATENCY_BUCKETS) bucket = EVENT_LATENCY_BUCKETS - 1;
+    
+    stats->histogram[bucket]++;
+    stats->delivered++;
+    if (latency > stats->max_latency_us) stats->max_latency_us = latency;
+}
+
+// Smallest bucket bound that covers the given share of deliveries
+static uint32_t latency_percentile(const EventLatencyStats* stats, uint32_t percent) {
+    uint64_t target = ((uint64_t)stats->delivered * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < EVENT_LATENCY_BUCKETS - 1; bucket++) {
+        seen += stats->histogram[bucket];
+        if (seen >= target) return (2u << bucket) - 1;
+    }
+    return stats->max_latency_us;
 }
 
 bool app_register(AppConfig* config) {
     if (framework.app_count >= MAX_APPS) return false;
-    if (find_app(config->name)) return false;
     
+    AppId id = intern(&app_names, config->name, true);
+    if (!id || app_from_id(id)) return false;
+    
+    framework.app_slots[id] = framework.app_count + 1;
     AppInstance* instance = &framework.apps[framework.app_count++];
     memcpy(&instance->config, config, sizeof(AppConfig));
+    instance->id = id;
     instance->state = APP_STATE_CREATED;
     instance->memory_usage = 0;
+    instance->peak_memory_usage = 0;
     instance->cpu_usage = 0;
+    instance->cpu_time_us = 0;
+    instance->wakeups = 0;
+    instance->sampled_cpu_time_us = 0;
     instance->storage_usage = 0;
     instance->app_data = NULL;
+    instance->process_id = -1;
     
-    if (instance->config.on_create) {
-        instance->config.on_create();
-    }
+    // Owner id 0 is the system
+    if (++framework.next_owner_id == 0) framework.next_owner_id = 1;
+    instance->owner_id = framework.next_owner_id;
+    memory_trace_name_owner(instance->owner_id, instance->config.name);
+    
+    run_app_callback(instance, instance->config.on_create);
     
     return true;
 }
@@ -61,11 +532,10 @@ bool app_start(const char* app_name) {
     AppInstance* app = find_app(app_name);
     if (!app || app->state != APP_STATE_CREATED) return false;
     
-    if (app->config.on_start) {
-        app->config.on_start();
-    }
+    run_app_callback(app, app->config.on_start);
     
     app->state = APP_STATE_RUNNING;
+    update_process_boost(app);
     return true;
 }
 
@@ -73,11 +543,10 @@ bool app_pause(const char* app_name) {
     AppInstance* app = find_app(app_name);
     if (!app || app->state != APP_STATE_RUNNING) return false;
     
-    if (app->config.on_pause) {
-        app->config.on_pause();
-    }
+    run_app_callback(app, app->config.on_pause);
     
     app->state = APP_STATE_PAUSED;
+    update_process_boost(app);
     return true;
 }
 
@@ -85,11 +554,10 @@ bool app_resume(const char* app_name) {
     AppInstance* app = find_app(app_name);
     if (!app || app->state != APP_STATE_PAUSED) return false;
     
-    if (app->config.on_resume) {
-        app->config.on_resume();
-    }
+    run_app_callback(app, app->config.on_resume);
     
     app->state = APP_STATE_RUNNING;
+    update_process_boost(app);
     return true;
 }
 
@@ -97,11 +565,10 @@ bool app_stop(const char* app_name) {
     AppInstance* app = find_app(app_name);
     if (!app || (app->state != APP_STATE_RUNNING && app->state != APP_STATE_PAUSED)) return false;
     
-    if (app->config.on_stop) {
-        app->config.on_stop();
-    }
+    run_app_callback(app, app->config.on_stop);
     
     app->state = APP_STATE_STOPPED;
+    update_process_boost(app);
     return true;
 }
 
@@ -109,48 +576,112 @@ bool app_unregister(const char* app_name) {
     AppInstance* app = find_app(app_name);
     if (!app) return false;
     
-    if (app->config.on_destroy) {
-        app->config.on_destroy();
-    }
+    run_app_callback(app, app->config.on_destroy);
     
     // Free all resources
+    if (app->process_id >= 0) {
+        process_set_boost(app->process_id, 0);
+        process_set_cpu_limit(app->process_id, 0);
+    }
     if (app->app_data) {
         app_free_memory(app_name, app->app_data);
     }
     
     // Remove app from array
     int index = app - framework.apps;
+    release_app_subscriptions(app->id, 0);
+    drop_app_events(app->id);
+    framework.app_slots[app->id] = 0;
     if (index < framework.app_count - 1) {
         memmove(&framework.apps[index], &framework.apps[index + 1], 
                 (framework.app_count - index - 1) * sizeof(AppInstance));
     }
     framework.app_count--;
+    for (int i = index; i < framework.app_count; i++) {
+        framework.app_slots[framework.apps[i].id] = (uint8_t)(i + 1);
+    }
     
     return true;
 }
 
-void* app_allocate_memory(const char* app_name, size_t size) {
+bool app_attach_process(const char* app_name, int pid) {
+    AppInstance* app = find_app(app_name);
+    if (!app) return false;
+    
+    // The previous process returns to its base priority, unthrottled, and
+    // keeps the usage it ran up for this app
+    if (app->process_id >= 0) {
+        fold_process_usage(app);
+        process_set_boost(app->process_id, 0);
+        process_set_cpu_limit(app->process_id, 0);
+    }
+    app->process_id = pid;
+    
+    // Only usage from here on is the app's
+    ProcessStats stats = {0};
+    process_get_stats(pid, &stats);
+    app->process_time_seen = stats.run_time_us;
+    app->process_wakeups_seen = stats.wakeups;
+    
+    update_process_boost(app);
+    if (pid >= 0) {
+        process_set_cpu_limit(pid, app->config.resource_limits.max_cpu_percent);
+    }
+    return true;
+}
+
+AppId app_get_id(const char* app_name) {
     AppInstance* app = find_app(app_name);
+    return app ? app->id : 0;
+}
+
+void* app_allocate_memory(const char* app_name, size_t size) {
+    return app_allocate_memory_id(intern(&app_names, app_name, false), size);
+}
+
+bool app_free_memory(const char* app_name, void* ptr) {
+    return app_free_memory_id(intern(&app_names, app_name, false), ptr);
+}
+
+void* app_allocate_memory_id(AppId app_id, size_t size) {
+    AppInstance* app = app_from_id(app_id);
     if (!app) return NULL;
     
     // Check if allocation would exceed limits
-    if (app->memory_usage + size > app->config.resource_limits.max_memory_kb * 1024) {
+    size_t limit = (size_t)app->config.resource_limits.max_memory_kb * 1024;
+    if (app->memory_usage + size > limit) {
         return NULL;
     }
     
+    uint16_t previous = memory_set_owner(app->owner_id);
     void* ptr = memory_allocate(size);
-    if (ptr) {
-        app->memory_usage += size;
+    memory_set_owner(previous);
+    if (!ptr) return NULL;
+    
+    // Charge what the allocator actually reserved, so frees balance exactly.
+    // The rounding counts against the limit too.
+    size_t charged = memory_usable_size(ptr);
+    if (app->memory_usage + charged > limit) {
+        memory_free(ptr);
+        return NULL;
+    }
+    app->memory_usage += charged;
+    if (app->memory_usage > app->peak_memory_usage) {
+        app->peak_memory_usage = app->memory_usage;
     }
     return ptr;
 }
 
-bool app_free_memory(const char* app_name, void* ptr) {
-    AppInstance* app = find_app(app_name);
+bool app_free_memory_id(AppId app_id, void* ptr) {
+    AppInstance* app = app_from_id(app_id);
     if (!app || !ptr) return false;
     
-    // Note: In a real implementation, we'd need to track the size of each allocation
-    // to properly update memory_usage
+    // Only the app's own allocations, so no app can skew another's usage
+    if (memory_get_owner(ptr) != app->owner_id) return false;
+    size_t size = memory_usable_size(ptr);
+    if (size == 0) return false;
+    
+    app->memory_usage -= size < app->memory_usage ? size : app->memory_usage;
     memory_free(ptr);
     return true;
 }
@@ -175,42 +706,259 @@ bool app_release_storage(const char* app_name, size_t size) {
     return true;
 }
 
-bool app_register_event_handler(const char* app_name, const char* event_name, EventHandler handler) {
-    if (!find_app(app_name)) return false;
-    
-    Event* event = find_event(event_name);
-    if (!event) {
-        if (framework.event_count >= MAX_EVENTS) return false;
-        event = &framework.events[framework.event_count++];
-        strncpy(event->name, event_name, sizeof(event->name) - 1);
-        event->handler_count = 0;
-    }
+SubscriptionId app_subscribe(const char* app_name, const char* topic, EventHandler handler) {
+    // Only intern the topic for a real app
+    AppId app_id = intern(&app_names, app_name, false);
+    if (!app_from_id(app_id)) return 0;
+    return app_subscribe_id(app_id, topic_intern(topic, true), handler);
+}
+
+SubscriptionId app_subscribe_id(AppId app_id, EventId event_id, EventHandler handler) {
+    if (!app_from_id(app_id) || !topic_from_id(event_id) || !handler) return 0;
     
-    if (event->handler_count >= MAX_HANDLERS_PER_EVENT) return false;
+    SubscriptionId id = subscription_alloc(app_id, event_id, handler);
+    if (!id) return 0;
     
-    event->handlers[event->handler_count++] = handler;
+    // A pattern joins every matching topic seen so far; topic_intern adds
+    // it to later ones
+    bool added = true;
+    if (!topics.items[event_id].pattern) {
+        added = topic_add_subscriber(event_id, id);
+    } else {
+        const char* pattern = topic_names.names[event_id - 1];
+        for (uint32_t i = 1; added && i <= topic_names.count && i < topics.capacity; i++) {
+            if (!topics.items[i].pattern && topic_matches(pattern, topic_names.names[i - 1])) {
+                added = topic_add_subscriber((EventId)i, id);
+            }
+        }
+    }
+    if (!added) {
+        subscription_release(id);
+        return 0;
+    }
+    return id;
+}
+
+bool app_unsubscribe(SubscriptionId subscription) {
+    if (!subscription_from_id(subscription)) return false;
+    subscription_release(subscription);
     return true;
 }
 
+bool app_register_event_handler(const char* app_name, const char* event_name, EventHandler handler) {
+    return app_subscribe(app_name, event_name, handler) != 0;
+}
+
+bool app_register_event_handler_id(AppId app_id, EventId event_id, EventHandler handler) {
+    return app_subscribe_id(app_id, event_id, handler) != 0;
+}
+
 bool app_unregister_event_handler(const char* app_name, const char* event_name) {
-    if (!find_app(app_name)) return false;
-    
-    Event* event = find_event(event_name);
-    if (!event) return false;
+    AppInstance* app = find_app(app_name);
+    EventId event_id = intern(&topic_names, event_name, false);
+    if (!app || !event_id) return false;
     
-    // Remove all handlers for this app (in a real implementation, we'd need to track
-    // which handler belongs to which app)
-    event->handler_count = 0;
-    return true;
+    return release_app_subscriptions(app->id, event_id) > 0;
 }
 
 bool app_emit_event(const char* event_name, void* data) {
-    Event* event = find_event(event_name);
-    if (!event) return false;
+    // New topics are interned so pattern subscribers see them
+    return app_emit_event_id(topic_intern(event_name, true), data);
+}
+
+EventId app_get_event_id(const char* event_name) {
+    return topic_intern(event_name, true);
+}
+
+bool app_emit_event_id(EventId event_id, void* data) {
+    Topic* topic = topic_from_id(event_id);
+    if (!topic || topic->pattern) return false;
+    
+    // Handlers may subscribe, which can move the list, or unsubscribe,
+    // which only marks entries stale while any dispatch is running. Ones
+    // added now first see the next event.
+    uint32_t count = topic->subscriber_count;
+    bool delivered = false;
+    framework.dispatch_depth++;
+    
+    // Each dispatch is timed and billed to the subscribing app, which also
+    // owns what the handler allocates, as with queued delivery
+    uint64_t start = monotonic_us();
+    for (uint32_t i = 0; i < count; i++) {
+        Subscription* subscription = subscription_from_id(topics.items[event_id].subscribers[i]);
+        if (!subscription) continue;
+        
+        AppId owner = subscription->owner;
+        AppInstance* app = app_from_id(owner);
+        uint16_t previous = app ? memory_set_owner(app->owner_id) : 0;
+        subscription->handler(data);
+        if (app) memory_set_owner(previous);
+        delivered = true;
+        
+        // A handler may have unregistered its own app
+        uint64_t end = monotonic_us();
+        app = app_from_id(owner);
+        if (app) charge_app(app, end - start);
+        start = end;
+    }
     
-    for (int i = 0; i < event->handler_count; i++) {
-        event->handlers[i](data);
+    framework.dispatch_depth--;
+    return delivered;
+}
+
+static bool post_event(EventId event_id, void* data, EventPriority priority, bool coalesce, uint32_t key) {
+    Topic* topic = topic_from_id(event_id);
+    if (!topic || topic->pattern || priority < 0 || priority >= EVENT_PRIORITY_LANES) return false;
+    
+    uint64_t now = monotonic_us();
+    bool queued_all = true;
+    for (uint32_t i = 0; i < topic->subscriber_count; i++) {
+        SubscriptionId subscription_id = topic->subscribers[i];
+        Subscription* subscription = subscription_from_id(subscription_id);
+        if (!subscription) continue;
+        EventLane* lane = &event_bus.lanes[subscription->owner][priority];
+        
+        // Coalescing scans the subscriber's lane; lanes are short
+        if (coalesce) {
+            QueuedEvent* pending = NULL;
+            for (uint16_t link = lane->head; link && !pending; link = event_bus.entries[link - 1].next) {
+                QueuedEvent* entry = &event_bus.entries[link - 1];
+                if (entry->coalesce && entry->event_id == event_id && entry->subscription == subscription_id &&
+                    entry->key == key) {
+                    pending = entry;
+                }
+            }
+            if (pending) {
+                // Keeps its place and post time; latency counts from the first post
+                pending->data = data;
+                topic->stats.coalesced++;
+                continue;
+            }
+        }
+        
+        QueuedEvent* entry = entry_alloc();
+        if (!entry) {
+            topic->stats.dropped++;
+            queued_all = false;
+            continue;
+        }
+        entry->subscription = subscription_id;
+        entry->event_id = event_id;
+        entry->coalesce = coalesce;
+        entry->key = key;
+        entry->data = data;
+        entry->posted_us = now;
+        lane_push(lane, entry);
+    }
+    return queued_all;
+}
+
+bool app_post_event(const char* event_name, void* data, EventPriority priority) {
+    return post_event(topic_intern(event_name, true), data, priority, false, 0);
+}
+
+bool app_post_event_id(EventId event_id, void* data, EventPriority priority) {
+    return post_event(event_id, data, priority, false, 0);
+}
+
+bool app_post_event_coalesced(EventId event_id, uint32_t key, void* data, EventPriority priority) {
+    return post_event(event_id, data, priority, true, key);
+}
+
+// Serve lanes in priority order. Within a lane apps take turns, each
+// running up to a batch of its deliveries per turn as one wakeup.
+uint32_t app_dispatch_events(uint32_t max_events) {
+    uint32_t delivered = 0;
+    for (int priority = 0; priority < EVENT_PRIORITY_LANES; priority++) {
+        bool progress = true;
+        while (progress && delivered < max_events) {
+            progress = false;
+            for (int i = 0; i < framework.app_count && delivered < max_events; i++) {
+                AppInstance* app = &framework.apps[i];
+                AppId app_id = app->id;
+                EventLane* lane = &event_bus.lanes[app_id][priority];
+                if (!lane->head) continue;
+                progress = true;
+                
+                uint16_t previous = memory_set_owner(app->owner_id);
+                uint64_t start = monotonic_us();
+                for (int n = 0; n < EVENT_DISPATCH_BATCH && delivered < max_events; n++) {
+                    QueuedEvent* entry = lane_pop(lane);
+                    if (!entry) break;
+                    
+                    // Free the entry first so the handler may post again
+                    QueuedEvent delivery = *entry;
+                    entry_free(entry);
+                    delivered++;
+                    
+                    // Skip subscriptions dropped since the post
+                    Subscription* subscription = subscription_from_id(delivery.subscription);
+                    if (!subscription || subscription->owner != app_id) continue;
+                    record_latency(&topics.items[delivery.event_id].stats, monotonic_us() - delivery.posted_us);
+                    subscription->handler(delivery.data);
+                    
+                    // A handler may have unregistered its own app
+                    if (app_from_id(app_id) != app) break;
+                }
+                if (app_from_id(app_id) == app) charge_app(app, monotonic_us() - start);
+                memory_set_owner(previous);
+            }
+        }
     }
+    return delivered;
+}
+
+bool app_events_pending(void) {
+    return event_bus.pending > 0;
+}
+
+bool app_get_event_stats(EventId event_id, EventLatencyStats* stats) {
+    Topic* topic = topic_from_id(event_id);
+    if (!topic || !stats) return false;
     
+    *stats = topic->stats;
+    stats->p50_latency_us = latency_percentile(&topic->stats, 50);
+    stats->p99_latency_us = latency_percentile(&topic->stats, 99);
     return true;
 }
+
+size_t app_get_usage_snapshot(AppUsageSnapshot* entries, size_t max_entries) {
+    uint64_t now = monotonic_us();
+    uint64_t interval = now - framework.last_snapshot_us;
+    framework.last_snapshot_us = now;
+    
+    size_t count = 0;
+    for (int i = 0; i < framework.app_count; i++) {
+        AppInstance* app = &framework.apps[i];
+        fold_process_usage(app);
+        
+        uint64_t used = app->cpu_time_us - app->sampled_cpu_time_us;
+        app->sampled_cpu_time_us = app->cpu_time_us;
+        app->cpu_usage = interval ? (uint32_t)(used * 100 / interval) : 0;
+        if (app->cpu_usage > 100) app->cpu_usage = 100;
+        
+        if (!entries || max_entries == 0) continue;
+        
+        AppUsageSnapshot row;
+        memcpy(row.name, app->config.name, sizeof(row.name));
+        row.state = app->state;
+        row.cpu_usage = app->cpu_usage;
+        row.cpu_time_us = app->cpu_time_us;
+        row.wakeups = app->wakeups;
+        row.memory_usage = app->memory_usage;
+        ProcessStats stats;
+        row.throttled = app->process_id >= 0 && process_get_stats(app->process_id, &stats) && stats.throttled;
+        
+        // Insertion sort, busiest first; the table is small
+        size_t position = count < max_entries ? count : max_entries;
+        while (position > 0 && entries[position - 1].cpu_usage < row.cpu_usage) {
+            if (position < max_entries) entries[position] = entries[position - 1];
+            position--;
+        }
+        if (position < max_entries) {
+            entries[position] = row;
+            if (count < max_entries) count++;
+        }
+    }
+    return count;
+}
@@ -1,9 +1,15 @@
 #ifndef APP_FRAMEWORK_H
 #define APP_FRAMEWORK_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
+// Interned app and topic names. An id stays bound to its name for the
+// life of the system, so it can be cached; 0 is never valid.
+typedef uint16_t AppId;
+typedef uint16_t EventId;
+
 // App lifecycle states
 typedef enum {
     APP_STATE_CREATED,
@@ -17,7 +23,7 @@ typedef enum {
 // Resource usage limits
 typedef struct {
     uint32_t max_memory_kb;
-    uint32_t max_cpu_percent;
+    uint32_t max_cpu_percent;      // 0 for no limit
     uint32_t max_storage_kb;
     bool background_allowed;
     bool network_access;
@@ -42,11 +48,31 @@ typedef struct {
     AppConfig config;
     AppState state;
     uint32_t memory_usage;
-    uint32_t cpu_usage;
+    uint32_t peak_memory_usage;
+    uint32_t cpu_usage;      // Percent of CPU since the previous usage snapshot
+    uint64_t cpu_time_us;    // Process run time plus callback and handler time
+    uint32_t wakeups;        // Process dispatches plus callbacks and handlers run
     uint32_t storage_usage;
+    AppId id;
+    uint16_t owner_id;       // Memory owner tag for allocation tracing
+    int process_id;          // Attached process, or -1
+    uint64_t process_time_seen;    // Process counters already folded in
+    uint32_t process_wakeups_seen;
+    uint64_t sampled_cpu_time_us;  // cpu_time_us at the previous snapshot
     void* app_data;
 } AppInstance;
 
+// One row of a top-style usage snapshot
+typedef struct {
+    char name[32];
+    AppState state;
+    uint32_t cpu_usage;      // Percent since the previous snapshot
+    uint64_t cpu_time_us;
+    uint32_t wakeups;
+    uint32_t memory_usage;
+    bool throttled;          // Its process is over max_cpu_percent
+} AppUsageSnapshot;
+
 // App Framework API
 bool app_register(AppConfig* config);
 bool app_start(const char* app_name);
@@ -55,16 +81,97 @@ bool app_resume(const char* app_name);
 bool app_stop(const char* app_name);
 bool app_unregister(const char* app_name);
 
+// Attach the process doing an app's work. Its priority is then boosted
+// while the app runs in the foreground and lowered while it is paused or
+// stopped, and it is throttled to the app's max_cpu_percent. Pass -1 to
+// detach.
+bool app_attach_process(const char* app_name, int pid);
+
+// Fill up to max_entries rows, busiest app first, and return the number
+// written. cpu_usage covers the time since the previous call.
+size_t app_get_usage_snapshot(AppUsageSnapshot* entries, size_t max_entries);
+
+// Id of a registered app, or 0
+AppId app_get_id(const char* app_name);
+
 // Resource Management API
 void* app_allocate_memory(const char* app_name, size_t size);
 bool app_free_memory(const char* app_name, void* ptr);
+void* app_allocate_memory_id(AppId app_id, size_t size);
+bool app_free_memory_id(AppId app_id, void* ptr);
 bool app_request_storage(const char* app_name, size_t size);
 bool app_release_storage(const char* app_name, size_t size);
 
 // Event System
+//
+// Events are published on topics, whose names are levels separated by '/',
+// e.g. "net/status/wifi". A subscription may instead name a pattern: a '*'
+// level matches any one level, and a final '#' level matches any number of
+// remaining levels, none included ("net/#" matches "net" too). Patterns
+// cannot be published to.
 typedef void (*EventHandler)(void* data);
+
+// Handle to one subscription. It goes stale once unsubscribed, so a kept
+// copy can never remove someone else's; 0 is never valid.
+typedef uint32_t SubscriptionId;
+
+SubscriptionId app_subscribe(const char* app_name, const char* topic, EventHandler handler);
+bool app_unsubscribe(SubscriptionId subscription);
+
+// Subscribe and return whether it took. Unregistering drops every handler
+// the app has on that topic or pattern; other apps' are left alone.
 bool app_register_event_handler(const char* app_name, const char* event_name, EventHandler handler);
 bool app_unregister_event_handler(const char* app_name, const char* event_name);
+
+// Call every handler subscribed to the topic, now. Returns false if none was.
 bool app_emit_event(const char* event_name, void* data);
 
+// Id for a topic or pattern, interning it if new (0 if out of space). Hot
+// paths such as per-frame emission should look the id up once and use the
+// _id calls.
+EventId app_get_event_id(const char* event_name);
+SubscriptionId app_subscribe_id(AppId app_id, EventId event_id, EventHandler handler);
+bool app_register_event_handler_id(AppId app_id, EventId event_id, EventHandler handler);
+bool app_emit_event_id(EventId event_id, void* data);
+
+// Deferred delivery. Posting queues one delivery per subscription on its app's
+// queue and returns at once; the kernel loop runs them in batches, higher
+// lanes first. Call from the kernel thread (processes included); other
+// threads go through kernel_post_event(). data must stay valid until
+// delivered. Returns false if any delivery was dropped for lack of space.
+typedef enum {
+    EVENT_PRIORITY_HIGH,
+    EVENT_PRIORITY_NORMAL,
+    EVENT_PRIORITY_LOW,
+    EVENT_PRIORITY_LANES
+} EventPriority;
+
+bool app_post_event(const char* event_name, void* data, EventPriority priority);
+bool app_post_event_id(EventId event_id, void* data, EventPriority priority);
+
+// As app_post_event_id, but a delivery of the same event and key still
+// pending for a handler just takes the new payload, e.g. for repeated
+// invalidations where only the latest state matters
+bool app_post_event_coalesced(EventId event_id, uint32_t key, void* data, EventPriority priority);
+
+// Deliver up to max_events queued events and return how many ran
+uint32_t app_dispatch_events(uint32_t max_events);
+bool app_events_pending(void);
+
+// Delivery statistics for one event. Latency runs from post to handler.
+#define EVENT_LATENCY_BUCKETS 16
+
+typedef struct {
+    uint32_t delivered;
+    uint32_t coalesced;      // Posts merged into a pending delivery
+    uint32_t dropped;        // Deliveries lost to a full queue
+    uint32_t max_latency_us;
+    uint32_t p50_latency_us; // Upper bound of the bucket holding the percentile
+    uint32_t p99_latency_us;
+    uint32_t histogram[EVENT_LATENCY_BUCKETS];  // Bucket n: [2^n, 2^(n+1)) us, 0 included
+                                                // in the first, all longer in the last
+} EventLatencyStats;
+
+bool app_get_event_stats(EventId event_id, EventLatencyStats* stats);
+
 #endif // APP_FRAMEWORK_H
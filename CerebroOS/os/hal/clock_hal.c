@@ -1,11 +1,55 @@
+#if defined(__linux__)
+#define _POSIX_C_SOURCE 199309L  // clock_gettime
+#endif
 #include "clock_hal.h"
-#include "../kernel/memory_manager.h"
+#include "../../kernel/memory_manager.h"
 #include <string.h>
 
 // Maximum number of hardware timers and alarms
 #define MAX_HW_TIMERS 8
 #define MAX_HW_ALARMS 8
 
+// Timing wheel: WHEEL_LEVELS levels of WHEEL_SLOTS slots. Level-0 slots are
+// 1 ms wide and each level is WHEEL_SLOTS times coarser than the one below,
+// so four levels cover about 4.6 hours ahead.
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1u << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (1ull << (WHEEL_BITS * WHEEL_LEVELS))
+#define WHEEL_EXPIRED WHEEL_LEVELS  // Level of timers waiting for their callback
+
+// Software timers are allocated in chunks that never move
+#define TIMER_CHUNK_SIZE 256
+#define MAX_TIMER_CHUNKS 64          // Up to 16384 timers
+
+// The hardware timer the wheel is multiplexed onto
+#define WHEEL_HW_TIMER 0
+
+typedef struct SoftTimer {
+    struct SoftTimer* prev;
+    struct SoftTimer* next;
+    TimerConfig config;
+    uint64_t deadline;    // Nominal expiry (uptime ms); periods advance from it
+    uint64_t expires;     // Tick it fires at: deadline rounded within its slack
+    uint16_t index;       // Position in the chunk table
+    uint16_t generation;  // Bumped on release so stale handles are rejected
+    uint8_t level;
+    uint8_t slot;
+    bool active;
+} SoftTimer;
+
+static struct {
+    SoftTimer* slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t occupied[WHEEL_LEVELS];   // Bit n set while slots[level][n] is non-empty
+    SoftTimer* expired;                // Due timers during hal_timer_dispatch
+    uint64_t tick;                     // Next tick to process
+    uint64_t next_expiry;              // Earliest expiry, never later than the true one
+    SoftTimer* chunks[MAX_TIMER_CHUNKS];
+    uint32_t chunk_count;
+    SoftTimer* free_list;
+} wheel;
+
 // Internal state tracking
 typedef struct {
     bool initialized;
@@ -13,8 +57,8 @@ typedef struct {
     bool wakeup_enabled;
     RTCConfig rtc_config;
     RTCAlarm alarms[MAX_HW_ALARMS];
-    TimerConfig timers[MAX_HW_TIMERS];
-    bool timer_active[MAX_HW_TIMERS];
+    bool timers_initialized;
+    SoftTimerHandle timer_handles[MAX_HW_TIMERS];
     uint64_t system_start_time;
 } ClockHALState;
 
@@ -27,6 +71,8 @@ static ClockHALError platform_rtc_write(uint8_t hour, uint8_t min, uint8_t sec);
 static ClockHALError platform_timer_init(void);
 static ClockHALError platform_timer_start(uint8_t timer_id, uint32_t interval_ms);
 static ClockHALError platform_timer_stop(uint8_t timer_id);
+static uint64_t platform_monotonic_ms(void);
+static uint64_t platform_monotonic_us(void);
 
 // RTC Functions Implementation
 ClockHALError hal_rtc_init(const RTCConfig* config) {
@@ -40,8 +86,10 @@ ClockHALError hal_rtc_init(const RTCConfig* config) {
     }
 
     memcpy(&hal_state.rtc_config, config, sizeof(RTCConfig));
+    if (!hal_state.initialized) {
+        hal_state.system_start_time = platform_monotonic_ms();
+    }
     hal_state.initialized = true;
-    hal_state.system_start_time = 0; // Set to current platform time
 
     return CLOCK_HAL_SUCCESS;
 }
@@ -95,8 +143,186 @@ ClockHALError hal_rtc_get_alarm(uint8_t alarm_id, RTCAlarm* alarm) {
 }
 
 // Timer Functions Implementation
+
+static uint64_t uptime_now(void) {
+    return platform_monotonic_ms() - hal_state.system_start_time;
+}
+
+static SoftTimer* timer_from_handle(SoftTimerHandle handle) {
+    uint32_t index = (handle & 0xFFFFu) - 1;
+    if (index >= wheel.chunk_count * TIMER_CHUNK_SIZE) return NULL;
+
+    SoftTimer* timer = &wheel.chunks[index / TIMER_CHUNK_SIZE][index % TIMER_CHUNK_SIZE];
+    if (!timer->active || timer->generation != (uint16_t)(handle >> 16)) return NULL;
+    return timer;
+}
+
+static SoftTimer* timer_alloc(void) {
+    if (!wheel.free_list) {
+        if (wheel.chunk_count == MAX_TIMER_CHUNKS) return NULL;
+
+        SoftTimer* chunk = memory_allocate(TIMER_CHUNK_SIZE * sizeof(SoftTimer));
+        if (!chunk) return NULL;
+        memset(chunk, 0, TIMER_CHUNK_SIZE * sizeof(SoftTimer));
+        for (uint32_t i = TIMER_CHUNK_SIZE; i-- > 0;) {
+            chunk[i].index = (uint16_t)(wheel.chunk_count * TIMER_CHUNK_SIZE + i);
+            chunk[i].next = wheel.free_list;
+            wheel.free_list = &chunk[i];
+        }
+        wheel.chunks[wheel.chunk_count++] = chunk;
+    }
+
+    SoftTimer* timer = wheel.free_list;
+    wheel.free_list = timer->next;
+    timer->active = true;
+    return timer;
+}
+
+static void timer_release(SoftTimer* timer) {
+    timer->active = false;
+    timer->generation++;  // Outstanding handles go stale
+    timer->next = wheel.free_list;
+    wheel.free_list = timer;
+}
+
+// Move the expiry within [deadline, deadline + slack] to the coarsest
+// power-of-two boundary the window allows, so timers with overlapping
+// windows land on the same tick and share one wakeup
+static uint64_t apply_slack(uint64_t deadline, uint32_t slack_ms) {
+    if (slack_ms == 0) return deadline;
+    uint64_t granularity = 1ull << (63 - __builtin_clzll((uint64_t)slack_ms + 1));
+    return (deadline + granularity - 1) & ~(granularity - 1);
+}
+
+static bool wheel_empty(void) {
+    for (uint8_t level = 0; level < WHEEL_LEVELS; level++) {
+        if (wheel.occupied[level]) return false;
+    }
+    return true;
+}
+
+static void wheel_link(SoftTimer** head, SoftTimer* timer) {
+    timer->prev = NULL;
+    timer->next = *head;
+    if (*head) (*head)->prev = timer;
+    *head = timer;
+}
+
+static void wheel_unlink(SoftTimer* timer) {
+    SoftTimer** head = timer->level == WHEEL_EXPIRED ? &wheel.expired :
+                       &wheel.slots[timer->level][timer->slot];
+    if (timer->prev) timer->prev->next = timer->next;
+    else *head = timer->next;
+    if (timer->next) timer->next->prev = timer->prev;
+
+    if (timer->level != WHEEL_EXPIRED && !*head) {
+        wheel.occupied[timer->level] &= ~(1ull << timer->slot);
+    }
+}
+
+// File the timer in the level whose slot width matches its distance from
+// the wheel position. Deadlines beyond the wheel's span park in the top
+// level and are refiled when that slot cascades.
+static void wheel_insert(SoftTimer* timer) {
+    uint64_t expires = timer->expires < wheel.tick ? wheel.tick : timer->expires;
+    uint64_t delta = expires - wheel.tick;
+    if (delta >= WHEEL_SPAN) {
+        delta = WHEEL_SPAN - 1;
+        expires = wheel.tick + delta;
+    }
+
+    uint8_t level = 0;
+    while (delta >= (1ull << (WHEEL_BITS * (level + 1)))) level++;
+    timer->level = level;
+    timer->slot = (uint8_t)((expires >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    wheel_link(&wheel.slots[level][timer->slot], timer);
+    wheel.occupied[level] |= 1ull << timer->slot;
+}
+
+static void wheel_cascade(uint8_t level, uint8_t slot) {
+    SoftTimer* timer = wheel.slots[level][slot];
+    wheel.slots[level][slot] = NULL;
+    wheel.occupied[level] &= ~(1ull << slot);
+
+    while (timer) {
+        SoftTimer* next = timer->next;
+        wheel_insert(timer);
+        timer = next;
+    }
+}
+
+// Process ticks up to and including now, collecting due timers on the
+// expired list. Runs of empty level-0 slots are skipped, so the cost is
+// set by level boundaries crossed, not by elapsed milliseconds.
+static void wheel_advance(uint64_t now) {
+    while (wheel.tick <= now) {
+        if (wheel_empty()) {
+            wheel.tick = now + 1;
+            break;
+        }
+
+        for (uint8_t level = 1; level < WHEEL_LEVELS; level++) {
+            uint32_t shift = WHEEL_BITS * level;
+            if (wheel.tick & ((1ull << shift) - 1)) break;
+            wheel_cascade(level, (uint8_t)((wheel.tick >> shift) & WHEEL_MASK));
+        }
+
+        uint8_t slot = (uint8_t)(wheel.tick & WHEEL_MASK);
+        SoftTimer* timer = wheel.slots[0][slot];
+        wheel.slots[0][slot] = NULL;
+        wheel.occupied[0] &= ~(1ull << slot);
+        while (timer) {
+            SoftTimer* next = timer->next;
+            timer->level = WHEEL_EXPIRED;
+            wheel_link(&wheel.expired, timer);
+            timer = next;
+        }
+
+        // Next occupied level-0 slot in this lap, else the next boundary
+        uint64_t later = wheel.occupied[0] & ~((2ull << slot) - 1);
+        uint64_t next_tick = later ? (wheel.tick & ~(uint64_t)WHEEL_MASK) + (uint64_t)__builtin_ctzll(later)
+                                   : (wheel.tick | WHEEL_MASK) + 1;
+        wheel.tick = next_tick <= now ? next_tick : now + 1;
+    }
+}
+
+// Earliest expiry on the wheel. Within a level, slots ahead of the wheel
+// position hold increasing time ranges, so only the first occupied slot of
+// each level needs scanning.
+static uint64_t wheel_earliest(void) {
+    uint64_t earliest = UINT64_MAX;
+    for (uint8_t level = 0; level < WHEEL_LEVELS; level++) {
+        uint64_t occupied = wheel.occupied[level];
+        if (!occupied) continue;
+
+        // A higher level's current slot has already cascaded unless the
+        // wheel sits exactly on its boundary
+        uint32_t shift = WHEEL_BITS * level;
+        uint32_t start = (uint32_t)((wheel.tick >> shift) & WHEEL_MASK);
+        if (level > 0 && (wheel.tick & ((1ull << shift) - 1))) start = (start + 1) & WHEEL_MASK;
+
+        uint64_t rotated = start ? (occupied >> start) | (occupied << (WHEEL_SLOTS - start)) : occupied;
+        uint32_t slot = (start + (uint32_t)__builtin_ctzll(rotated)) & WHEEL_MASK;
+        for (SoftTimer* timer = wheel.slots[level][slot]; timer; timer = timer->next) {
+            if (timer->expires < earliest) earliest = timer->expires;
+        }
+    }
+    return earliest;
+}
+
+// Point the one hardware timer at the earliest expiry
+static void program_hw_timer(void) {
+    if (wheel.next_expiry == UINT64_MAX) {
+        platform_timer_stop(WHEEL_HW_TIMER);
+        return;
+    }
+    uint64_t now = uptime_now();
+    uint64_t delay = wheel.next_expiry > now ? wheel.next_expiry - now : 0;
+    platform_timer_start(WHEEL_HW_TIMER, delay > UINT32_MAX ? UINT32_MAX : (uint32_t)delay);
+}
+
 ClockHALError hal_timer_init(void) {
-    if (hal_state.initialized) {
+    if (hal_state.timers_initialized) {
         return CLOCK_HAL_SUCCESS;
     }
 
@@ -105,43 +331,151 @@ ClockHALError hal_timer_init(void) {
         return err;
     }
 
-    memset(hal_state.timer_active, 0, sizeof(hal_state.timer_active));
+    if (!hal_state.initialized) {
+        hal_state.system_start_time = platform_monotonic_ms();
+        hal_state.initialized = true;
+    }
+    memset(hal_state.timer_handles, 0, sizeof(hal_state.timer_handles));
+    wheel.tick = uptime_now();
+    wheel.next_expiry = UINT64_MAX;
+    hal_state.timers_initialized = true;
+    return CLOCK_HAL_SUCCESS;
+}
+
+ClockHALError hal_soft_timer_start(const TimerConfig* config, SoftTimerHandle* handle) {
+    if (!hal_state.timers_initialized || !config || !handle) {
+        return CLOCK_HAL_ERROR_PARAM;
+    }
+
+    SoftTimer* timer = timer_alloc();
+    if (!timer) {
+        return CLOCK_HAL_ERROR_BUSY;
+    }
+
+    // An idle wheel may lag behind; catch it up so the timer is filed at
+    // the finest level its distance allows
+    uint64_t now = uptime_now();
+    if (wheel_empty() && now > wheel.tick) wheel.tick = now;
+
+    timer->config = *config;
+    timer->deadline = now + config->interval_ms;
+    timer->expires = apply_slack(timer->deadline, config->slack_ms);
+    wheel_insert(timer);
+
+    // Only an earlier expiry needs the hardware timer moved
+    if (timer->expires < wheel.next_expiry) {
+        wheel.next_expiry = timer->expires;
+        program_hw_timer();
+    }
+
+    *handle = ((uint32_t)timer->generation << 16) | (uint32_t)(timer->index + 1);
+    return CLOCK_HAL_SUCCESS;
+}
+
+ClockHALError hal_soft_timer_cancel(SoftTimerHandle handle) {
+    SoftTimer* timer = timer_from_handle(handle);
+    if (!timer) {
+        return CLOCK_HAL_SUCCESS;  // Already expired or cancelled
+    }
+
+    // The hardware timer is left alone; an early wakeup just finds nothing due
+    wheel_unlink(timer);
+    timer_release(timer);
+    return CLOCK_HAL_SUCCESS;
+}
+
+ClockHALError hal_soft_timer_get_remaining(SoftTimerHandle handle, uint32_t* remaining_ms) {
+    if (!remaining_ms) {
+        return CLOCK_HAL_ERROR_PARAM;
+    }
+
+    SoftTimer* timer = timer_from_handle(handle);
+    uint64_t now = uptime_now();
+    *remaining_ms = (timer && timer->expires > now) ? (uint32_t)(timer->expires - now) : 0;
     return CLOCK_HAL_SUCCESS;
 }
 
 ClockHALError hal_timer_start(uint8_t timer_id, const TimerConfig* config) {
-    if (!hal_state.initialized || timer_id >= MAX_HW_TIMERS || !config) {
+    if (!hal_state.timers_initialized || timer_id >= MAX_HW_TIMERS || !config) {
         return CLOCK_HAL_ERROR_PARAM;
     }
 
-    if (hal_state.timer_active[timer_id]) {
+    if (timer_from_handle(hal_state.timer_handles[timer_id])) {
         return CLOCK_HAL_ERROR_BUSY;
     }
 
-    ClockHALError err = platform_timer_start(timer_id, config->interval_ms);
-    if (err == CLOCK_HAL_SUCCESS) {
-        memcpy(&hal_state.timers[timer_id], config, sizeof(TimerConfig));
-        hal_state.timer_active[timer_id] = true;
+    return hal_soft_timer_start(config, &hal_state.timer_handles[timer_id]);
+}
+
+ClockHALError hal_timer_stop(uint8_t timer_id) {
+    if (!hal_state.timers_initialized || timer_id >= MAX_HW_TIMERS) {
+        return CLOCK_HAL_ERROR_PARAM;
     }
 
+    ClockHALError err = hal_soft_timer_cancel(hal_state.timer_handles[timer_id]);
+    hal_state.timer_handles[timer_id] = 0;
     return err;
 }
 
-ClockHALError hal_timer_stop(uint8_t timer_id) {
-    if (!hal_state.initialized || timer_id >= MAX_HW_TIMERS) {
+ClockHALError hal_timer_get_remaining(uint8_t timer_id, uint32_t* remaining_ms) {
+    if (!hal_state.timers_initialized || timer_id >= MAX_HW_TIMERS || !remaining_ms) {
         return CLOCK_HAL_ERROR_PARAM;
     }
 
-    if (!hal_state.timer_active[timer_id]) {
-        return CLOCK_HAL_SUCCESS;
+    return hal_soft_timer_get_remaining(hal_state.timer_handles[timer_id], remaining_ms);
+}
+
+ClockHALError hal_timer_is_active(uint8_t timer_id, bool* active) {
+    if (!hal_state.timers_initialized || timer_id >= MAX_HW_TIMERS || !active) {
+        return CLOCK_HAL_ERROR_PARAM;
     }
 
-    ClockHALError err = platform_timer_stop(timer_id);
-    if (err == CLOCK_HAL_SUCCESS) {
-        hal_state.timer_active[timer_id] = false;
+    *active = timer_from_handle(hal_state.timer_handles[timer_id]) != NULL;
+    return CLOCK_HAL_SUCCESS;
+}
+
+uint32_t hal_timer_next_expiry(void) {
+    if (!hal_state.timers_initialized || wheel.next_expiry == UINT64_MAX) return UINT32_MAX;
+
+    uint64_t now = uptime_now();
+    if (wheel.next_expiry <= now) return 0;
+    uint64_t remaining = wheel.next_expiry - now;
+    return remaining >= UINT32_MAX ? UINT32_MAX - 1 : (uint32_t)remaining;
+}
+
+void hal_timer_dispatch(void) {
+    if (!hal_state.timers_initialized) return;
+
+    // Nothing can be due before the cached expiry
+    uint64_t now = uptime_now();
+    if (now < wheel.next_expiry) return;
+
+    wheel_advance(now);
+    SoftTimer* timer;
+    while ((timer = wheel.expired)) {
+        wheel_unlink(timer);
+
+        // Rearm (or retire) before the callback so it may restart or cancel
+        // the timer. Periods advance from the nominal deadline, not the
+        // coalesced expiry, so slack never accumulates as drift.
+        TimerConfig config = timer->config;
+        if (config.repeat && config.interval_ms > 0) {
+            timer->deadline += config.interval_ms;
+            if (timer->deadline <= now) {
+                timer->deadline = now + config.interval_ms;
+            }
+            timer->expires = apply_slack(timer->deadline, config.slack_ms);
+            wheel_insert(timer);
+        } else {
+            timer_release(timer);
+        }
+        if (config.callback) {
+            config.callback(config.callback_data);
+        }
     }
 
-    return err;
+    wheel.next_expiry = wheel_earliest();
+    program_hw_timer();
 }
 
 // Power Management Implementation
@@ -180,8 +514,16 @@ ClockHALError hal_clock_get_uptime(uint64_t* uptime_ms) {
         return CLOCK_HAL_ERROR_INIT;
     }
 
-    // Platform-specific uptime calculation would go here
-    *uptime_ms = 0; // Placeholder
+    *uptime_ms = platform_monotonic_ms() - hal_state.system_start_time;
+    return CLOCK_HAL_SUCCESS;
+}
+
+ClockHALError hal_clock_get_uptime_us(uint64_t* uptime_us) {
+    if (!hal_state.initialized || !uptime_us) {
+        return CLOCK_HAL_ERROR_INIT;
+    }
+
+    *uptime_us = platform_monotonic_us() - hal_state.system_start_time * 1000u;
     return CLOCK_HAL_SUCCESS;
 }
 
@@ -234,3 +576,18 @@ static ClockHALError platform_timer_stop(uint8_t timer_id) {
     // Hardware-specific timer stop
     return CLOCK_HAL_SUCCESS;
 }
+
+static uint64_t platform_monotonic_ms(void) {
+    return platform_monotonic_us() / 1000u;
+}
+
+static uint64_t platform_monotonic_us(void) {
+#if defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+#else
+    // Hardware-specific free-running counter read
+    return 0;
+#endif
+}
@@ -34,8 +34,12 @@ typedef struct {
     bool repeat;
     void (*callback)(void* data);
     void* callback_data;
+    uint32_t slack_ms;       // May fire up to this late so nearby timers share a wakeup
 } TimerConfig;
 
+// Software timer handle, 0 is never valid
+typedef uint32_t SoftTimerHandle;
+
 // Power Management
 typedef enum {
     CLOCK_POWER_NORMAL,
@@ -69,6 +73,21 @@ ClockHALError hal_timer_stop(uint8_t timer_id);
 ClockHALError hal_timer_get_remaining(uint8_t timer_id, uint32_t* remaining_ms);
 ClockHALError hal_timer_is_active(uint8_t timer_id, bool* active);
 
+// Software timers. Any number of one-shot and periodic timers (up to a
+// few thousand) share one hardware timer through a hierarchical timing
+// wheel; starting and cancelling are O(1). hal_timer_start() ids are
+// software timers too.
+ClockHALError hal_soft_timer_start(const TimerConfig* config, SoftTimerHandle* handle);
+ClockHALError hal_soft_timer_cancel(SoftTimerHandle handle);
+ClockHALError hal_soft_timer_get_remaining(SoftTimerHandle handle, uint32_t* remaining_ms);
+
+// Milliseconds until the earliest active timer expires, or UINT32_MAX if
+// none is running. Lets an idle loop sleep exactly until the next expiry.
+uint32_t hal_timer_next_expiry(void);
+
+// Run the callbacks of expired timers and rearm repeating ones
+void hal_timer_dispatch(void);
+
 // Power Management Functions
 ClockHALError hal_clock_set_power_mode(ClockPowerMode mode);
 ClockHALError hal_clock_get_power_mode(ClockPowerMode* mode);
@@ -76,6 +95,7 @@ ClockHALError hal_clock_enable_wakeup(bool enable);
 
 // Utility Functions
 ClockHALError hal_clock_get_uptime(uint64_t* uptime_ms);
+ClockHALError hal_clock_get_uptime_us(uint64_t* uptime_us);
 ClockHALError hal_clock_get_battery_status(uint8_t* battery_percent);
 bool hal_clock_is_charging(void);
 
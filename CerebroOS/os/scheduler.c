@@ -1,11 +1,458 @@
+#define _POSIX_C_SOURCE 200809L  // clock_gettime, pthreads
 #include "scheduler.h"
-#include <stdio.h>
+#include "hal.h"
+#include "../kernel/memory_manager.h"
+#include <string.h>
+#include <time.h>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#define MAX_PERIODIC_TASKS 16
+
+// Work-stealing pool. Slot 0 belongs to the thread that started the
+// workers (the kernel loop), which runs tasks while it joins.
+#define MAX_WORKERS 16
+#define WORKER_DEQUE_SIZE 1024              // Power of two
+#define WORKER_IDLE_SPINS 64                // Failed steal rounds before sleeping
+#define WORKER_SLEEP_NS (5 * 1000 * 1000)   // Upper bound on a missed wakeup
+#define PARALLEL_FOR_MAX_CHUNKS 64
+#define MAX_DETACHED_TASKS 64               // schedule_task futures in flight
+
+// Share of the CPU, in parts per thousand, that admitted periodic tasks may
+// claim. The rest is left to the UI and apps in the kernel loop.
+#define PERIODIC_UTILIZATION_LIMIT 700
+
+typedef struct {
+    bool active;
+    PeriodicTaskParams params;
+    uint64_t next_release;
+    uint64_t release;            // Release time of the pending job
+    uint64_t deadline;           // Absolute deadline of the pending job
+    bool pending;
+    uint32_t density;            // budget / min(period, deadline), per mille
+    PeriodicTaskStats stats;
+} PeriodicTask;
+
+static struct {
+    PeriodicTask tasks[MAX_PERIODIC_TASKS];
+    uint32_t density_total;
+} periodic;
+
+// Chase-Lev deque. The owner pushes and takes at the bottom; thieves take
+// from the top. Only the last element needs a CAS between owner and thief.
+typedef struct {
+    atomic_llong top;
+    atomic_llong bottom;
+    _Atomic(SchedulerTask*) buffer[WORKER_DEQUE_SIZE];
+} WorkDeque;
+
+static struct {
+    WorkDeque deques[MAX_WORKERS];
+    int worker_count;                   // Deques in use, including slot 0
+    int thread_count;                   // Worker threads actually started
+    atomic_bool running;
+#if defined(__linux__)
+    pthread_t threads[MAX_WORKERS];
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+#endif
+    atomic_int sleepers;
+} pool;
+
+// Deque slot of the calling thread, or -1 outside the pool
+static _Thread_local int worker_index = -1;
+
+static uint64_t scheduler_now_us(void) {
+#if defined(__linux__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+#else
+    return (uint64_t)hal_get_uptime() * 1000u;
+#endif
+}
+
+// schedule_task's future; the SchedulerTask comes first so the handle
+// given out is also the slot. Slots are claimed with an atomic swap rather
+// than taken from the heap, which is not safe to use from worker threads.
+typedef struct {
+    SchedulerTask task;
+    void (*function)(void);
+    atomic_bool in_use;
+} DetachedTask;
+
+static DetachedTask detached_tasks[MAX_DETACHED_TASKS];
 
 void init_scheduler() {
-    printf("Scheduler initialized.\n");
+    memset(&periodic, 0, sizeof(periodic));
+}
+
+static void run_detached_task(void* arg) {
+    ((DetachedTask*)arg)->function();
+}
+
+SchedulerTask* schedule_task(void (*task)(void)) {
+    for (int i = 0; i < MAX_DETACHED_TASKS; i++) {
+        DetachedTask* detached = &detached_tasks[i];
+        if (atomic_exchange_explicit(&detached->in_use, true, memory_order_acquire)) continue;
+        
+        detached->function = task;
+        scheduler_submit(&detached->task, run_detached_task, detached);
+        return &detached->task;
+    }
+    return NULL;
+}
+
+void scheduler_release_task(SchedulerTask* task) {
+    DetachedTask* detached = (DetachedTask*)task;
+    if (detached < detached_tasks || detached >= detached_tasks + MAX_DETACHED_TASKS) return;
+    scheduler_join(task);
+    atomic_store_explicit(&detached->in_use, false, memory_order_release);
+}
+
+int scheduler_add_periodic(const PeriodicTaskParams* params) {
+    if (!params || !params->job || params->period_us == 0 || params->budget_us == 0) return -1;
+    
+    uint32_t deadline = params->deadline_us ? params->deadline_us : params->period_us;
+    if (deadline > params->period_us || params->budget_us > deadline) return -1;
+    
+    // Density test: sufficient for EDF with deadlines at or before the period
+    uint32_t density = (uint32_t)(((uint64_t)params->budget_us * 1000 + deadline - 1) / deadline);
+    if (periodic.density_total + density > PERIODIC_UTILIZATION_LIMIT) return -1;
+    
+    for (int i = 0; i < MAX_PERIODIC_TASKS; i++) {
+        PeriodicTask* task = &periodic.tasks[i];
+        if (task->active) continue;
+        
+        memset(task, 0, sizeof(*task));
+        task->active = true;
+        task->params = *params;
+        task->params.deadline_us = deadline;
+        task->density = density;
+        task->next_release = scheduler_now_us();
+        periodic.density_total += density;
+        return i;
+    }
+    return -1;
+}
+
+void scheduler_remove_periodic(int task_id) {
+    if (task_id < 0 || task_id >= MAX_PERIODIC_TASKS || !periodic.tasks[task_id].active) return;
+    
+    periodic.tasks[task_id].active = false;
+    periodic.density_total -= periodic.tasks[task_id].density;
+}
+
+bool scheduler_get_periodic_stats(int task_id, PeriodicTaskStats* stats) {
+    if (task_id < 0 || task_id >= MAX_PERIODIC_TASKS || !periodic.tasks[task_id].active || !stats) return false;
+    
+    *stats = periodic.tasks[task_id].stats;
+    return true;
+}
+
+// Release every job whose time has come. A job still pending at its next
+// release missed its deadline and is replaced; releases the loop slept
+// through entirely are skipped and also counted as misses.
+static void release_jobs(uint64_t now) {
+    for (int i = 0; i < MAX_PERIODIC_TASKS; i++) {
+        PeriodicTask* task = &periodic.tasks[i];
+        if (!task->active || now < task->next_release) continue;
+        
+        if (task->pending) task->stats.deadline_misses++;
+        
+        uint64_t behind = (now - task->next_release) / task->params.period_us;
+        task->stats.deadline_misses += (uint32_t)behind;
+        task->release = task->next_release + behind * task->params.period_us;
+        task->deadline = task->release + task->params.deadline_us;
+        task->next_release = task->release + task->params.period_us;
+        task->pending = true;
+        task->stats.releases++;
+    }
+}
+
+uint32_t scheduler_run_periodic(void) {
+    uint64_t now = scheduler_now_us();
+    release_jobs(now);
+    
+    while (1) {
+        // Earliest deadline among pending jobs
+        PeriodicTask* next = NULL;
+        for (int i = 0; i < MAX_PERIODIC_TASKS; i++) {
+            PeriodicTask* task = &periodic.tasks[i];
+            if (task->active && task->pending && (!next || task->deadline < next->deadline)) {
+                next = task;
+            }
+        }
+        if (!next) break;
+        
+        uint64_t start = scheduler_now_us();
+        next->pending = false;
+        next->params.job(next->params.context);
+        now = scheduler_now_us();
+        
+        next->stats.completions++;
+        if (now > next->deadline) next->stats.deadline_misses++;
+        if (now - start > next->params.budget_us) next->stats.budget_overruns++;
+        if (now - next->release > next->stats.worst_response_us) {
+            next->stats.worst_response_us = (uint32_t)(now - next->release);
+        }
+        
+        // Jobs may have come due while this one ran
+        release_jobs(now);
+    }
+    
+    uint64_t wake = UINT64_MAX;
+    for (int i = 0; i < MAX_PERIODIC_TASKS; i++) {
+        if (periodic.tasks[i].active && periodic.tasks[i].next_release < wake) {
+            wake = periodic.tasks[i].next_release;
+        }
+    }
+    if (wake == UINT64_MAX) return UINT32_MAX;
+    return wake > now ? (uint32_t)(wake - now) : 0;
+}
+
+static bool deque_push(WorkDeque* deque, SchedulerTask* task) {
+    long long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (b - t >= WORKER_DEQUE_SIZE) return false;
+    
+    atomic_store_explicit(&deque->buffer[b & (WORKER_DEQUE_SIZE - 1)], task, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+static SchedulerTask* deque_take(WorkDeque* deque) {
+    long long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    
+    if (t > b) {
+        // Empty
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    
+    SchedulerTask* task = atomic_load_explicit(&deque->buffer[b & (WORKER_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (t == b) {
+        // Last element: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+static SchedulerTask* deque_steal(WorkDeque* deque) {
+    long long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (t >= b) return NULL;
+    
+    SchedulerTask* task = atomic_load_explicit(&deque->buffer[t & (WORKER_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+static void run_task(SchedulerTask* task) {
+    task->function(task->arg);
+    atomic_store_explicit(&task->done, true, memory_order_release);
+}
+
+// Run one task from our own deque or, failing that, stolen from another
+static bool run_one_task(int self) {
+    SchedulerTask* task = deque_take(&pool.deques[self]);
+    for (int i = 1; !task && i < pool.worker_count; i++) {
+        task = deque_steal(&pool.deques[(self + i) % pool.worker_count]);
+    }
+    if (!task) return false;
+    
+    run_task(task);
+    return true;
+}
+
+#if defined(__linux__)
+static void* worker_main(void* arg) {
+    worker_index = (int)(intptr_t)arg;
+    int idle = 0;
+    
+    while (atomic_load_explicit(&pool.running, memory_order_acquire)) {
+        if (run_one_task(worker_index)) {
+            idle = 0;
+            continue;
+        }
+        if (++idle < WORKER_IDLE_SPINS) {
+            sched_yield();
+            continue;
+        }
+        
+        // Sleep until a submit signals; the timeout covers a signal sent
+        // between our last steal attempt and the wait
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += WORKER_SLEEP_NS;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&pool.idle_lock);
+        atomic_fetch_add(&pool.sleepers, 1);
+        if (atomic_load(&pool.running)) {
+            pthread_cond_timedwait(&pool.idle_cond, &pool.idle_lock, &until);
+        }
+        atomic_fetch_sub(&pool.sleepers, 1);
+        pthread_mutex_unlock(&pool.idle_lock);
+        idle = 0;
+    }
+    
+    // Pool blocks cached by this thread would otherwise be stranded
+    memory_flush_thread_cache();
+    return NULL;
+}
+#endif
+
+int scheduler_start_workers(int count) {
+#if defined(__linux__)
+    if (pool.worker_count > 0) return pool.thread_count;
+    
+    if (count <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cores > 1 ? (int)cores - 1 : 0;
+    }
+    if (count > MAX_WORKERS - 1) count = MAX_WORKERS - 1;
+    if (count == 0) return 0;
+    
+    for (int i = 0; i <= count; i++) {
+        atomic_init(&pool.deques[i].top, 0);
+        atomic_init(&pool.deques[i].bottom, 0);
+    }
+    pthread_mutex_init(&pool.idle_lock, NULL);
+    pthread_cond_init(&pool.idle_cond, NULL);
+    atomic_store(&pool.sleepers, 0);
+    atomic_store(&pool.running, true);
+    
+    // Fixed before any thread starts; a deque whose thread failed to start
+    // simply stays empty
+    worker_index = 0;
+    pool.worker_count = count + 1;
+    pool.thread_count = 0;
+    for (int i = 1; i <= count; i++) {
+        if (pthread_create(&pool.threads[i], NULL, worker_main, (void*)(intptr_t)i) != 0) break;
+        pool.thread_count++;
+    }
+    return pool.thread_count;
+#else
+    (void)count;
+    return 0;
+#endif
+}
+
+void scheduler_stop_workers(void) {
+#if defined(__linux__)
+    if (pool.worker_count == 0 || worker_index != 0) return;
+    
+    // Drain what is still queued so no future is left unfinished
+    while (run_one_task(0)) {
+    }
+    
+    pthread_mutex_lock(&pool.idle_lock);
+    atomic_store(&pool.running, false);
+    pthread_cond_broadcast(&pool.idle_cond);
+    pthread_mutex_unlock(&pool.idle_lock);
+    for (int i = 1; i <= pool.thread_count; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+    
+    // Tasks still running above may have queued more on their own deques;
+    // with the workers gone, run those here. Later submits run inline.
+    while (run_one_task(0)) {
+    }
+    pthread_cond_destroy(&pool.idle_cond);
+    pthread_mutex_destroy(&pool.idle_lock);
+    pool.worker_count = 0;
+    worker_index = -1;
+#endif
+}
+
+void scheduler_submit(SchedulerTask* task, void (*function)(void* arg), void* arg) {
+    task->function = function;
+    task->arg = arg;
+    atomic_init(&task->done, false);
+    
+    // Threads outside the pool, or a full deque, run the task right away
+    if (worker_index < 0 || !atomic_load_explicit(&pool.running, memory_order_relaxed) ||
+        !deque_push(&pool.deques[worker_index], task)) {
+        run_task(task);
+        return;
+    }
+    
+#if defined(__linux__)
+    if (atomic_load_explicit(&pool.sleepers, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&pool.idle_lock);
+        pthread_cond_signal(&pool.idle_cond);
+        pthread_mutex_unlock(&pool.idle_lock);
+    }
+#endif
+}
+
+void scheduler_join(SchedulerTask* task) {
+    while (!atomic_load_explicit(&task->done, memory_order_acquire)) {
+        // Help instead of blocking; the task may even be in our own deque
+        if (worker_index < 0 || !run_one_task(worker_index)) {
+#if defined(__linux__)
+            sched_yield();
+#endif
+        }
+    }
+}
+
+typedef struct {
+    void (*function)(size_t index, void* context);
+    void* context;
+    size_t begin;
+    size_t end;
+} ParallelChunk;
+
+static void run_parallel_chunk(void* arg) {
+    ParallelChunk* chunk = arg;
+    for (size_t i = chunk->begin; i < chunk->end; i++) {
+        chunk->function(i, chunk->context);
+    }
 }
 
-void schedule_task(void (*task)()) {
-    printf("Scheduling task...\n");
-    task();
+void scheduler_parallel_for(size_t count, void (*function)(size_t index, void* context), void* context) {
+    if (count == 0) return;
+    
+    // A few chunks per worker evens out uneven per-index cost
+    size_t chunks = (size_t)(pool.worker_count > 0 ? pool.worker_count : 1) * 4;
+    if (chunks > PARALLEL_FOR_MAX_CHUNKS) chunks = PARALLEL_FOR_MAX_CHUNKS;
+    if (chunks > count) chunks = count;
+    
+    SchedulerTask tasks[PARALLEL_FOR_MAX_CHUNKS];
+    ParallelChunk ranges[PARALLEL_FOR_MAX_CHUNKS];
+    for (size_t i = 0; i < chunks; i++) {
+        ranges[i] = (ParallelChunk){
+            .function = function,
+            .context = context,
+            .begin = count * i / chunks,
+            .end = count * (i + 1) / chunks
+        };
+    }
+    
+    // Queue all but the first chunk, which this thread runs itself
+    for (size_t i = 1; i < chunks; i++) {
+        scheduler_submit(&tasks[i], run_parallel_chunk, &ranges[i]);
+    }
+    run_parallel_chunk(&ranges[0]);
+    for (size_t i = 1; i < chunks; i++) {
+        scheduler_join(&tasks[i]);
+    }
 }
@@ -1,7 +1,78 @@
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
 void init_scheduler();
-void schedule_task(void (*task)());
+
+// Work-stealing task pool. Each worker thread owns a deque; idle workers
+// steal from the others. Without workers (device builds, or before
+// scheduler_start_workers) tasks run inline on submit.
+//
+// Task functions may run on worker threads, where only the memory
+// manager's pool blocks are safe to allocate, and only with tracing off:
+// the heap, large spans, owner tags and trace ring belong to the kernel
+// thread. Allocate what a task needs before submitting it.
+//
+// A SchedulerTask is caller-owned storage that doubles as the future: it
+// must stay alive until scheduler_join() returns for it.
+typedef struct {
+    void (*function)(void* arg);
+    void* arg;
+    atomic_bool done;
+} SchedulerTask;
+
+// Start worker threads; 0 picks one per spare core. Returns the number
+// started.
+int scheduler_start_workers(int count);
+void scheduler_stop_workers(void);
+
+// Queue a task. Tasks may submit and join further tasks.
+void scheduler_submit(SchedulerTask* task, void (*function)(void* arg), void* arg);
+
+// Wait for a task, running other queued tasks in the meantime
+void scheduler_join(SchedulerTask* task);
+
+// Submit a task with pool-owned storage. Returns its future, or NULL without
+// running it if all MAX_DETACHED_TASKS are in flight. Join it as usual,
+// then hand it back with scheduler_release_task, which also joins.
+SchedulerTask* schedule_task(void (*task)(void));
+void scheduler_release_task(SchedulerTask* task);
+
+// Run function(index, context) for every index in [0, count) across the
+// pool and return when all calls have finished
+void scheduler_parallel_for(size_t count, void (*function)(size_t index, void* context), void* context);
+
+// Periodic real-time class (audio refill, call media). Jobs run to
+// completion in earliest-deadline-first order each time the kernel loop
+// calls scheduler_run_periodic(). All times are in microseconds.
+typedef struct {
+    void (*job)(void* context);
+    void* context;
+    uint32_t period_us;
+    uint32_t budget_us;      // Worst-case execution time of one job
+    uint32_t deadline_us;    // Relative to each release; 0 means the period
+} PeriodicTaskParams;
+
+typedef struct {
+    uint32_t releases;
+    uint32_t completions;
+    uint32_t deadline_misses;   // Jobs finished late or skipped
+    uint32_t budget_overruns;   // Jobs that ran longer than budget_us
+    uint32_t worst_response_us; // Longest release-to-completion time
+} PeriodicTaskStats;
+
+// Admit a periodic task. Fails (returns -1) if the task set would no longer
+// be schedulable within the real-time share of the CPU.
+int scheduler_add_periodic(const PeriodicTaskParams* params);
+void scheduler_remove_periodic(int task_id);
+bool scheduler_get_periodic_stats(int task_id, PeriodicTaskStats* stats);
+
+// Release due jobs and run every pending one, earliest deadline first.
+// Returns the time until the next release, for the caller's idle sleep.
+uint32_t scheduler_run_periodic(void);
 
 #endif // SCHEDULER_H
@@ -0,0 +1,393 @@
+// Allocator microbenchmark. Replays allocation traces against each
+// MemoryAllocationStrategy and reports latency percentiles, peak footprint
+// and heap fragmentation.
+//
+// Usage: bench_alloc [trace.bin ...]
+//   Without arguments the built-in synthetic workloads are run. Each
+//   argument is a dump written by memory_trace_dump() and is replayed too.
+
+#define _POSIX_C_SOURCE 199309L
+#include "../../kernel/memory_manager.h"
+#include "../../kernel/memory_trace.h"
+#include "../../kernel/kernel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_LIVE_SLOTS 4096
+#define FRAG_SAMPLE_INTERVAL 16
+
+typedef enum {
+    BENCH_ALLOC,
+    BENCH_FREE
+} BenchOpType;
+
+typedef struct {
+    uint8_t op;      // BenchOpType
+    uint16_t slot;   // Index into the live pointer table
+    uint32_t size;
+} BenchOp;
+
+typedef struct {
+    const char* name;
+    BenchOp* ops;
+    size_t count;
+    size_t capacity;
+} Workload;
+
+typedef struct {
+    uint64_t alloc_p50, alloc_p99;
+    uint64_t free_p50, free_p99;
+    size_t peak_footprint;
+    float frag_mean;
+    float frag_max;
+    uint32_t failed;
+} BenchResult;
+
+// The memory manager only needs a clock and an event sink from the kernel
+uint32_t kernel_get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+bool kernel_post_event(const KernelEventRecord* event) {
+    (void)event;
+    return true;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Small deterministic PRNG so runs are comparable across machines
+static uint32_t rng_state;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi) {
+    return lo + rng_next() % (hi - lo + 1);
+}
+
+static void workload_push(Workload* w, BenchOpType op, uint16_t slot, uint32_t size) {
+    if (w->count == w->capacity) {
+        w->capacity = w->capacity ? w->capacity * 2 : 1024;
+        w->ops = realloc(w->ops, w->capacity * sizeof(BenchOp));
+    }
+    w->ops[w->count++] = (BenchOp){ .op = op, .slot = slot, .size = size };
+}
+
+// Tracks which slots are live while a synthetic workload is generated
+typedef struct {
+    uint16_t live[MAX_LIVE_SLOTS];
+    uint16_t live_count;
+    uint16_t free_slots[MAX_LIVE_SLOTS];
+    uint16_t free_count;
+} SlotSet;
+
+static void slots_init(SlotSet* set) {
+    set->live_count = 0;
+    set->free_count = MAX_LIVE_SLOTS;
+    for (int i = 0; i < MAX_LIVE_SLOTS; i++) {
+        set->free_slots[i] = (uint16_t)(MAX_LIVE_SLOTS - 1 - i);
+    }
+}
+
+static void gen_alloc(Workload* w, SlotSet* set, uint32_t size) {
+    if (set->free_count == 0) return;
+    uint16_t slot = set->free_slots[--set->free_count];
+    set->live[set->live_count++] = slot;
+    workload_push(w, BENCH_ALLOC, slot, size);
+}
+
+static void gen_free_at(Workload* w, SlotSet* set, uint16_t index) {
+    uint16_t slot = set->live[index];
+    set->live[index] = set->live[--set->live_count];
+    set->free_slots[set->free_count++] = slot;
+    workload_push(w, BENCH_FREE, slot, 0);
+}
+
+static void gen_free_random(Workload* w, SlotSet* set) {
+    if (set->live_count == 0) return;
+    gen_free_at(w, set, (uint16_t)(rng_next() % set->live_count));
+}
+
+// UI churn: widgets, strings and event records that live for a frame or
+// two, plus the odd offscreen surface
+static void gen_ui_churn(Workload* w) {
+    SlotSet set;
+    slots_init(&set);
+    rng_state = 0x1234567u;
+
+    for (int frame = 0; frame < 2000; frame++) {
+        int allocs = (int)rng_range(4, 24);
+        for (int i = 0; i < allocs; i++) {
+            uint32_t roll = rng_range(0, 99);
+            uint32_t size = roll < 60 ? rng_range(8, 64)
+                          : roll < 95 ? rng_range(65, 256)
+                          : rng_range(1024, 8192);
+            gen_alloc(w, &set, size);
+        }
+        while (set.live_count > 160) gen_free_random(w, &set);
+    }
+}
+
+// Note editing: a text buffer that grows by reallocation, with small undo
+// records kept in a bounded FIFO history
+#define NOTE_UNDO_DEPTH 200
+
+static void gen_note_edit(Workload* w) {
+    rng_state = 0x89abcdefu;
+
+    // Slots 0 and 1 alternate as the text buffer, the rest form the undo ring
+    uint16_t text_slot = 0;
+    uint32_t text_size = 256;
+    workload_push(w, BENCH_ALLOC, text_slot, text_size);
+
+    int undo_count = 0;
+    for (int edit = 0; edit < 6000; edit++) {
+        uint16_t undo_slot = (uint16_t)(2 + edit % NOTE_UNDO_DEPTH);
+        if (undo_count == NOTE_UNDO_DEPTH) {
+            workload_push(w, BENCH_FREE, undo_slot, 0);
+        } else {
+            undo_count++;
+        }
+        workload_push(w, BENCH_ALLOC, undo_slot, rng_range(24, 96));
+
+        if (rng_range(0, 9) == 0 && text_size < 24 * 1024) {
+            // Grow: the new buffer exists before the old one is released
+            text_size += text_size / 2;
+            workload_push(w, BENCH_ALLOC, (uint16_t)(text_slot ^ 1), text_size);
+            workload_push(w, BENCH_FREE, text_slot, 0);
+            text_slot ^= 1;
+        }
+    }
+}
+
+// Model loading: a burst of large long-lived tensors with small metadata,
+// released together when the model is swapped
+static void gen_model_load(Workload* w) {
+    SlotSet set;
+    slots_init(&set);
+    rng_state = 0x0badf00du;
+
+    for (int model = 0; model < 40; model++) {
+        int tensors = (int)rng_range(6, 14);
+        for (int i = 0; i < tensors; i++) {
+            gen_alloc(w, &set, rng_range(4 * 1024, 24 * 1024));
+            gen_alloc(w, &set, rng_range(32, 128));
+        }
+        while (set.live_count > 0) gen_free_at(w, &set, (uint16_t)(set.live_count - 1));
+    }
+}
+
+// Map trace addresses to slots with a small open-addressing table
+typedef struct {
+    uint64_t address;
+    uint16_t slot;
+    bool used;
+} AddressSlot;
+
+static bool load_trace(const char* path, Workload* w) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != TRACE_MAGIC || header.version != TRACE_VERSION ||
+        header.record_size != sizeof(TraceRecord) ||
+        fseek(file, (long)(header.owner_count * sizeof(TraceOwnerName)), SEEK_CUR) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    AddressSlot* table = calloc(MAX_LIVE_SLOTS * 2, sizeof(AddressSlot));
+    SlotSet set;
+    slots_init(&set);
+
+    TraceRecord record;
+    for (uint32_t i = 0; i < header.record_count; i++) {
+        if (fread(&record, sizeof(record), 1, file) != 1) break;
+        if (record.address == 0) continue;
+
+        size_t h = (size_t)(record.address >> 4) % (MAX_LIVE_SLOTS * 2);
+        if (record.op == TRACE_OP_ALLOC) {
+            if (set.free_count == 0) continue;
+            while (table[h].used) h = (h + 1) % (MAX_LIVE_SLOTS * 2);
+            uint16_t slot = set.free_slots[--set.free_count];
+            table[h] = (AddressSlot){ .address = record.address, .slot = slot, .used = true };
+            workload_push(w, BENCH_ALLOC, slot, record.size);
+        } else {
+            // Frees of blocks allocated before the ring wrapped are skipped
+            while (table[h].used && table[h].address != record.address) {
+                h = (h + 1) % (MAX_LIVE_SLOTS * 2);
+            }
+            if (!table[h].used) continue;
+            workload_push(w, BENCH_FREE, table[h].slot, 0);
+            set.free_slots[set.free_count++] = table[h].slot;
+
+            // Backward-shift deletion keeps probe chains intact
+            size_t hole = h;
+            size_t next = (h + 1) % (MAX_LIVE_SLOTS * 2);
+            table[hole].used = false;
+            while (table[next].used) {
+                size_t home = (size_t)(table[next].address >> 4) % (MAX_LIVE_SLOTS * 2);
+                if ((next > hole && (home <= hole || home > next)) ||
+                    (next < hole && (home <= hole && home > next))) {
+                    table[hole] = table[next];
+                    table[next].used = false;
+                    hole = next;
+                }
+                next = (next + 1) % (MAX_LIVE_SLOTS * 2);
+            }
+        }
+    }
+
+    free(table);
+    fclose(file);
+    return true;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(uint64_t* samples, size_t count, int pct) {
+    if (count == 0) return 0;
+    return samples[(count - 1) * pct / 100];
+}
+
+static size_t current_footprint(const MemoryUsageStats* stats) {
+    size_t total = stats->used_memory;
+    for (int i = 0; i < 3; i++) total += stats->pool_usage[i];
+    return total;
+}
+
+static BenchResult run_workload(const Workload* w, MemoryAllocationStrategy strategy) {
+    BenchResult result = { 0 };
+    static void* live[MAX_LIVE_SLOTS];
+    memset(live, 0, sizeof(live));
+
+    // Each run starts from a fresh manager
+    memory_init(strategy, POWER_MODE_NORMAL);
+
+    uint64_t* alloc_ns = malloc(w->count * sizeof(uint64_t));
+    uint64_t* free_ns = malloc(w->count * sizeof(uint64_t));
+    size_t alloc_count = 0;
+    size_t free_count = 0;
+    double frag_total = 0;
+    size_t frag_samples = 0;
+
+    for (size_t i = 0; i < w->count; i++) {
+        const BenchOp* op = &w->ops[i];
+        if (op->op == BENCH_ALLOC) {
+            uint64_t start = now_ns();
+            void* ptr = memory_allocate(op->size);
+            alloc_ns[alloc_count++] = now_ns() - start;
+            if (ptr) {
+                // Touch the block like a real caller would
+                memset(ptr, 0xA5, op->size < 64 ? op->size : 64);
+            } else {
+                result.failed++;
+            }
+            live[op->slot] = ptr;
+        } else {
+            if (!live[op->slot]) continue;
+            uint64_t start = now_ns();
+            memory_free(live[op->slot]);
+            free_ns[free_count++] = now_ns() - start;
+            live[op->slot] = NULL;
+        }
+
+        if (i % FRAG_SAMPLE_INTERVAL == 0) {
+            MemoryUsageStats stats = memory_get_stats();
+            size_t footprint = current_footprint(&stats);
+            if (footprint > result.peak_footprint) result.peak_footprint = footprint;
+            if (stats.fragmentation_percent > result.frag_max) result.frag_max = stats.fragmentation_percent;
+            frag_total += stats.fragmentation_percent;
+            frag_samples++;
+        }
+    }
+
+    for (int i = 0; i < MAX_LIVE_SLOTS; i++) {
+        if (live[i]) memory_free(live[i]);
+    }
+    memory_flush_thread_cache();
+
+    qsort(alloc_ns, alloc_count, sizeof(uint64_t), compare_u64);
+    qsort(free_ns, free_count, sizeof(uint64_t), compare_u64);
+    result.alloc_p50 = percentile(alloc_ns, alloc_count, 50);
+    result.alloc_p99 = percentile(alloc_ns, alloc_count, 99);
+    result.free_p50 = percentile(free_ns, free_count, 50);
+    result.free_p99 = percentile(free_ns, free_count, 99);
+    result.frag_mean = frag_samples ? (float)(frag_total / frag_samples) : 0.0f;
+
+    free(alloc_ns);
+    free(free_ns);
+    return result;
+}
+
+static void report(const Workload* w) {
+    static const struct {
+        MemoryAllocationStrategy strategy;
+        const char* name;
+    } strategies[] = {
+        // First fit and best fit both run on the TLSF heap index and
+        // measure the same; one row covers them
+        { MEMORY_ALLOC_FIRST_FIT, "tlsf" },
+        { MEMORY_ALLOC_POOL, "pool" }
+    };
+
+    printf("\n%s (%zu ops)\n", w->name, w->count);
+    printf("%-10s %10s %10s %10s %10s %12s %7s %7s %7s\n",
+           "strategy", "alloc p50", "alloc p99", "free p50", "free p99",
+           "peak bytes", "frag%", "max%", "failed");
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++) {
+        BenchResult r = run_workload(w, strategies[i].strategy);
+        printf("%-10s %8lluns %8lluns %8lluns %8lluns %12zu %7.1f %7.1f %7u\n",
+               strategies[i].name,
+               (unsigned long long)r.alloc_p50, (unsigned long long)r.alloc_p99,
+               (unsigned long long)r.free_p50, (unsigned long long)r.free_p99,
+               r.peak_footprint, r.frag_mean, r.frag_max, r.failed);
+    }
+}
+
+int main(int argc, char** argv) {
+    static const struct {
+        const char* name;
+        void (*generate)(Workload*);
+    } synthetic[] = {
+        { "ui-churn", gen_ui_churn },
+        { "note-edit", gen_note_edit },
+        { "model-load", gen_model_load }
+    };
+
+    for (size_t i = 0; i < sizeof(synthetic) / sizeof(synthetic[0]); i++) {
+        Workload w = { .name = synthetic[i].name };
+        synthetic[i].generate(&w);
+        report(&w);
+        free(w.ops);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        Workload w = { .name = argv[i] };
+        if (!load_trace(argv[i], &w)) {
+            fprintf(stderr, "%s: not a memory trace dump\n", argv[i]);
+            continue;
+        }
+        report(&w);
+        free(w.ops);
+    }
+
+    return 0;
+}